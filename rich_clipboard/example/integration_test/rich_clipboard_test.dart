@@ -1,3 +1,7 @@
+import 'dart:convert' show utf8;
+import 'dart:io' show Platform;
+import 'dart:typed_data';
+
 import 'package:flutter/services.dart';
 import 'package:flutter_test/flutter_test.dart';
 import 'package:rich_clipboard/rich_clipboard.dart';
@@ -18,4 +22,200 @@ void main() {
     expect(data, isNotNull);
     expect(data!.text, text);
   });
+
+  group('onChanged', () {
+    test('reports the types of data set by this application', () async {
+      final change = RichClipboard.onChanged.firstWhere(
+        (change) => change.types.contains('text/html'),
+      );
+      // Give the platform a moment to start watching.
+      await Future<void>.delayed(const Duration(milliseconds: 100));
+      await RichClipboard.setData(
+        const RichClipboardData(text: 'changed', html: '<b>changed</b>'),
+      );
+
+      final received = await change.timeout(const Duration(seconds: 5));
+      expect(received.types, contains('text/plain'));
+      expect(received.sequence, greaterThan(0));
+    });
+
+    test('numbers changes in order', () async {
+      final changes = <RichClipboardChange>[];
+      final subscription = RichClipboard.onChanged.listen(changes.add);
+      await Future<void>.delayed(const Duration(milliseconds: 100));
+      await RichClipboard.setData(const RichClipboardData(text: 'first'));
+      await Future<void>.delayed(const Duration(milliseconds: 200));
+      await RichClipboard.setData(const RichClipboardData(text: 'second'));
+      await Future<void>.delayed(const Duration(milliseconds: 200));
+      await subscription.cancel();
+
+      expect(changes, hasLength(greaterThanOrEqualTo(2)));
+      for (var i = 1; i < changes.length; i++) {
+        expect(changes[i].sequence, greaterThan(changes[i - 1].sequence));
+      }
+    });
+  }, skip: !Platform.isLinux);
+
+  group('setPromisedData', () {
+    test('renders only the types that are read, once each', () async {
+      final rendered = <String>[];
+      await RichClipboard.setPromisedData(['text/plain', 'text/html'],
+          (mimeType) {
+        rendered.add(mimeType);
+        return mimeType == 'text/plain' ? 'promised' : '<b>promised</b>';
+      });
+      expect(rendered, isEmpty);
+      expect(
+        await RichClipboard.getAvailableTypes(),
+        containsAll(<String>['text/plain', 'text/html']),
+      );
+
+      final text = await RichClipboard.getData(types: ['text/plain']);
+      expect(text.text, 'promised');
+      expect(rendered, ['text/plain']);
+
+      final data = await RichClipboard.getData();
+      expect(data.text, 'promised');
+      expect(data.html, '<b>promised</b>');
+      expect(rendered, ['text/plain', 'text/html']);
+    });
+
+    test('serves asynchronous providers', () async {
+      await RichClipboard.setPromisedData(['text/plain'], (mimeType) async {
+        await Future<void>.delayed(const Duration(milliseconds: 50));
+        return 'later';
+      });
+
+      final data = await Clipboard.getData(Clipboard.kTextPlain);
+      expect(data?.text, 'later');
+    });
+  }, skip: !Platform.isLinux);
+
+  group('binary data', () {
+    test('round-trips raw bytes of any type', () async {
+      final bytes = Uint8List.fromList(List.generate(4096, (i) => i % 256));
+      await RichClipboard.setBinaryData({
+        'application/x-rich-clipboard-test': bytes,
+        'text/plain': Uint8List.fromList(utf8.encode('caf\u00e9')),
+      });
+
+      final data = await RichClipboard.getBinaryData([
+        'application/x-rich-clipboard-test',
+        'text/plain',
+        'image/png',
+      ]);
+      expect(data.keys, hasLength(2));
+      expect(data['application/x-rich-clipboard-test'], bytes);
+      expect(utf8.decode(data['text/plain']!), 'caf\u00e9');
+    });
+
+    test('offers binary text to plain text readers', () async {
+      await RichClipboard.setBinaryData({
+        'text/plain': Uint8List.fromList(utf8.encode('from bytes')),
+      });
+
+      final data = await RichClipboard.getData();
+      expect(data.text, 'from bytes');
+    });
+  }, skip: !Platform.isLinux);
+
+  group('getData with types', () {
+    const both = RichClipboardData(text: 'both', html: '<i>both</i>');
+
+    test('reads only the requested types', () async {
+      await RichClipboard.setData(both);
+
+      expect(
+        await RichClipboard.getData(types: ['text/plain']),
+        const RichClipboardData(text: 'both'),
+      );
+      expect(
+        await RichClipboard.getData(types: ['text/html']),
+        const RichClipboardData(html: '<i>both</i>'),
+      );
+      expect(
+        await RichClipboard.getData(types: ['text/plain', 'text/html']),
+        both,
+      );
+    });
+
+    test('reads nothing for no types', () async {
+      await RichClipboard.setData(both);
+
+      expect(
+        await RichClipboard.getData(types: []),
+        const RichClipboardData(),
+      );
+    });
+  });
+
+  group('primary selection', () {
+    test('round-trips data apart from the clipboard', () async {
+      await RichClipboard.setData(const RichClipboardData(text: 'clipboard'));
+      await RichClipboard.setPrimaryData(
+        const RichClipboardData(text: 'selected', html: '<u>selected</u>'),
+      );
+
+      expect(
+        await RichClipboard.getPrimaryData(),
+        const RichClipboardData(text: 'selected', html: '<u>selected</u>'),
+      );
+      expect(
+        await RichClipboard.getPrimaryData(types: ['text/plain']),
+        const RichClipboardData(text: 'selected'),
+      );
+      expect((await RichClipboard.getData()).text, 'clipboard');
+    });
+
+    test('publishes the latest of coalesced updates', () async {
+      for (var i = 0; i < 10; i++) {
+        await RichClipboard.setPrimaryData(RichClipboardData(text: 'drag $i'));
+      }
+
+      // Updates after the first one wait for the coalescing interval.
+      String? text;
+      for (var attempt = 0; attempt < 20 && text != 'drag 9'; attempt++) {
+        await Future<void>.delayed(const Duration(milliseconds: 50));
+        text = (await RichClipboard.getPrimaryData()).text;
+      }
+      expect(text, 'drag 9');
+    });
+  }, skip: !Platform.isLinux);
+
+  group('hasTypes', () {
+    test('reports which types are available, in order', () async {
+      await RichClipboard.setData(
+        const RichClipboardData(text: 'typed', html: '<s>typed</s>'),
+      );
+
+      expect(
+        await RichClipboard.hasTypes(['image/png', 'text/html', 'text/plain']),
+        [false, true, true],
+      );
+    });
+
+    test('follows the clipboard as it changes', () async {
+      await RichClipboard.setData(const RichClipboardData(text: 'only text'));
+      expect(
+        await RichClipboard.hasTypes(['text/plain', 'text/html']),
+        [true, false],
+      );
+
+      await RichClipboard.setBinaryData({
+        'application/x-rich-clipboard-test': Uint8List.fromList([1, 2, 3]),
+      });
+      expect(
+        await RichClipboard.hasTypes(
+          ['text/plain', 'application/x-rich-clipboard-test'],
+        ),
+        [false, true],
+      );
+    });
+
+    test('rejects more than 64 types', () async {
+      final types = [for (var i = 0; i < 65; i++) 'application/x-type-$i'];
+
+      expect(RichClipboard.hasTypes(types), throwsA(isA<PlatformException>()));
+    });
+  }, skip: !Platform.isLinux);
 }
@@ -1,7 +1,15 @@
+import 'dart:typed_data';
+
 import 'package:rich_clipboard_platform_interface/rich_clipboard_platform_interface.dart';
 
 export 'package:rich_clipboard_platform_interface/rich_clipboard_platform_interface.dart'
-    show RichClipboardData;
+    show
+        RichClipboardChange,
+        RichClipboardData,
+        RichClipboardDataProvider,
+        RichClipboardDataStream,
+        RichClipboardHistoryItem,
+        RichClipboardImage;
 
 /// Utility methods for interacting with the system's clipboard with support for
 /// various data formats.
@@ -22,6 +30,16 @@ class RichClipboard {
   static Future<List<String>> getAvailableTypes() async =>
       await _platform.getAvailableTypes();
 
+  /// Checks which of the given MIME [types] the system clipboard can provide,
+  /// without reading any of them.
+  ///
+  /// The returned list holds one entry per type in [types], in order, so
+  /// `hasTypes(['text/html'])` is a cheap way to decide whether to enable a
+  /// "paste with formatting" action. On Linux, `text/plain` is available when
+  /// any text type is. At most 64 types may be checked at once.
+  static Future<List<bool>> hasTypes(List<String> types) async =>
+      _platform.hasTypes(types);
+
   /// Retrieves data from the system clipboard in supported formats.
   ///
   /// Platform code may convert from unsupported formats to provide data when it
@@ -29,12 +47,217 @@ class RichClipboard {
   /// available in the clipboard but RTF is, some platforms will convert the RTF
   /// to HTML which will then be included in the returned data.
   ///
+  /// Pass [types] to only read those MIME types, for example just
+  /// `['text/plain']` for a plain text field. The other fields of the result
+  /// are then `null`, and some platforms skip reading them entirely.
+  ///
   /// Returns a future which completes to a [RichClipboardData].
-  static Future<RichClipboardData> getData() async => await _platform.getData();
+  static Future<RichClipboardData> getData({List<String>? types}) async =>
+      types == null
+          ? await _platform.getData()
+          : await _platform.getDataOfTypes(types);
 
   /// Stores the provided data in the system clipboard.
   ///
   /// To clear the clipboard pass an empty [RichClipboardData].
   static Future<void> setData(RichClipboardData data) async =>
       _platform.setData(data);
+
+  /// Stores [html] in the system clipboard, along with plain text flattened
+  /// from it.
+  ///
+  /// Use this instead of [setData] to avoid building the plain text in Dart.
+  /// It is only built when another application pastes it.
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> setHtmlData(String html) async =>
+      _platform.setHtmlData(html);
+
+  /// Retrieves the primary selection, which holds whatever text is currently
+  /// selected and is pasted with a middle click.
+  ///
+  /// Pass [types] to only read some of `text/plain` and `text/html`.
+  ///
+  /// Currently only supported on Linux.
+  static Future<RichClipboardData> getPrimaryData({
+    List<String>? types,
+  }) async =>
+      _platform.getPrimaryData(types: types);
+
+  /// Makes the provided data the primary selection.
+  ///
+  /// It is fine to call this on every selection change, including during a
+  /// selection drag: only the latest selection is published, at most a few
+  /// times per second. To give up the selection pass an empty
+  /// [RichClipboardData].
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> setPrimaryData(RichClipboardData data) async =>
+      _platform.setPrimaryData(data);
+
+  /// Retrieves the raw bytes of the requested data types from the system
+  /// clipboard.
+  ///
+  /// [types] may contain any of the types reported by [getAvailableTypes], as
+  /// well as `text/plain`, which is returned as UTF-8. Types that are not
+  /// available are left out of the returned map.
+  ///
+  /// Currently only supported on Linux.
+  static Future<Map<String, Uint8List>> getBinaryData(
+    List<String> types,
+  ) async =>
+      _platform.getBinaryData(types);
+
+  /// Stores the provided map of data types to raw bytes in the system
+  /// clipboard, for example `image/png` or an application specific type.
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> setBinaryData(Map<String, Uint8List> data) async =>
+      _platform.setBinaryData(data);
+
+  /// Retrieves the image in the clipboard, scaled down to fit [maxWidth] and
+  /// [maxHeight] and encoded as [type], without decoding it in Dart. See
+  /// [RichClipboardPlatform.getImage].
+  ///
+  /// Currently only supported on Linux.
+  static Future<RichClipboardImage?> getImage({
+    int? maxWidth,
+    int? maxHeight,
+    String? type,
+    int? quality,
+  }) async =>
+      _platform.getImage(
+        maxWidth: maxWidth,
+        maxHeight: maxHeight,
+        type: type,
+        quality: quality,
+      );
+
+  /// Stores the image in [bytes], encoded as [type], in the clipboard, and
+  /// offers it in [encodings] as well, which are only produced when pasted.
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> setImage(
+    Uint8List bytes, {
+    String type = 'image/png',
+    List<String> encodings = RichClipboardPlatform.defaultImageEncodings,
+  }) async =>
+      _platform.setImage(bytes, type: type, encodings: encodings);
+
+  /// Stores the contents of files in the system clipboard, given as a map of
+  /// data types to file paths, without reading them into memory. The files
+  /// must stay unchanged while the clipboard holds them. See
+  /// [RichClipboardPlatform.setFileData].
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> setFileData(Map<String, String> files) async =>
+      _platform.setFileData(files);
+
+  /// Reads a single data type from the system clipboard in chunks of at most
+  /// [chunkSize] bytes, without ever holding the whole payload in Dart.
+  ///
+  /// The stream only requests the next chunk once the previous one has been
+  /// delivered, so pausing it pauses the transfer. Its length is known up
+  /// front. Returns a future that completes to `null` if [type] is not
+  /// available.
+  ///
+  /// Currently only supported on Linux.
+  static Future<RichClipboardDataStream?> openDataStream(
+    String type, {
+    int chunkSize = RichClipboardPlatform.defaultChunkSize,
+  }) async =>
+      _platform.openDataStream(type, chunkSize: chunkSize);
+
+  /// Stores data in the system clipboard that is only rendered when it is
+  /// requested.
+  ///
+  /// The clipboard advertises [types] (such as `text/plain` and `text/html`)
+  /// right away, and [provider] is called the first time something asks for
+  /// one of them. This makes copying large documents nearly instant, and
+  /// formats that are never pasted are never rendered.
+  ///
+  /// Promised data does not outlive the application.
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> setPromisedData(
+    List<String> types,
+    RichClipboardDataProvider provider,
+  ) async =>
+      _platform.setPromisedData(types, provider);
+
+  /// Waits for the system's clipboard manager to take a copy of the data this
+  /// application last stored, so that it stays available after the
+  /// application exits.
+  ///
+  /// [setData] starts the handoff without waiting for it. Returns a future
+  /// that completes to whether the manager took the data.
+  ///
+  /// Currently only supported on Linux.
+  static Future<bool> storeClipboard() async => _platform.storeClipboard();
+
+  /// Performance counters of the platform's clipboard handling, meant to be
+  /// forwarded to telemetry. See [RichClipboardPlatform.getStats] for the
+  /// values it holds.
+  ///
+  /// Currently only supported on Linux.
+  static Future<Map<String, Object?>> getStats() async =>
+      _platform.getStats();
+
+  /// Starts counting the values [getStats] reports from zero.
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> resetStats() async => _platform.resetStats();
+
+  /// Returns a fingerprint of the clipboard's content without reading it, or
+  /// `null` if it is not known without a read. See
+  /// [RichClipboardPlatform.getContentFingerprint].
+  ///
+  /// Currently only supported on Linux.
+  static Future<String?> getContentFingerprint() async =>
+      _platform.getContentFingerprint();
+
+  /// Starts keeping a history of the clipboard's text and HTML in native
+  /// memory, taking at most [maxBytes]. See
+  /// [RichClipboardPlatform.enableHistory].
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> enableHistory({
+    int maxBytes = RichClipboardPlatform.defaultHistoryMaxBytes,
+  }) async =>
+      _platform.enableHistory(maxBytes: maxBytes);
+
+  /// Stops keeping the history and drops its entries.
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> disableHistory() async => _platform.disableHistory();
+
+  /// Drops the entries of the history, which stays enabled.
+  ///
+  /// Currently only supported on Linux.
+  static Future<void> clearHistory() async => _platform.clearHistory();
+
+  /// Lists up to [limit] entries of the history, newest first, starting
+  /// after the entry with id [before] if it is given.
+  ///
+  /// Currently only supported on Linux.
+  static Future<List<RichClipboardHistoryItem>> getHistory({
+    int? before,
+    int limit = 50,
+  }) async =>
+      _platform.getHistory(before: before, limit: limit);
+
+  /// Retrieves the data of the history entry with [id], or `null` if it has
+  /// been dropped.
+  ///
+  /// Currently only supported on Linux.
+  static Future<RichClipboardData?> getHistoryEntry(int id) async =>
+      _platform.getHistoryEntry(id);
+
+  /// A stream of changes to the system clipboard.
+  ///
+  /// The platform only watches the clipboard while the stream has listeners,
+  /// so cancel subscriptions that are no longer needed.
+  ///
+  /// Currently only supported on Linux.
+  static Stream<RichClipboardChange> get onChanged => _platform.onChanged;
 }
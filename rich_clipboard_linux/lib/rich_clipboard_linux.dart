@@ -6,3 +6,4 @@
 // https://opensource.org/licenses/MIT.
 
 export 'src/rich_clipboard_linux.dart';
+export 'src/rich_clipboard_native.dart';
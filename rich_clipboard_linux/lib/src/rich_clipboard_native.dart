@@ -0,0 +1,78 @@
+import 'dart:async';
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+// Result codes of rich_clipboard_read_data, see rich_clipboard_native.h.
+const _kReadOk = 0;
+const _kReadNoPlugin = 2;
+const _kReadTimedOut = 3;
+
+typedef _ReadDataNative = Int32 Function(
+  Pointer<Utf8> mimeType,
+  Pointer<Pointer<Uint8>> data,
+  Pointer<IntPtr> length,
+);
+typedef _ReadData = int Function(
+  Pointer<Utf8> mimeType,
+  Pointer<Pointer<Uint8>> data,
+  Pointer<IntPtr> length,
+);
+
+/// Reads the Linux clipboard through the plugin's native library over FFI
+/// instead of the platform channel.
+///
+/// Unlike the methods of `RichClipboard`, these work from any isolate, and
+/// the bytes are handed over in native memory without being encoded for the
+/// channel. They are meant for background isolates reading large payloads.
+/// Each call blocks its isolate until the transfer has finished.
+class RichClipboardNative {
+  RichClipboardNative._();
+
+  static final _library =
+      DynamicLibrary.open('librich_clipboard_linux_plugin.so');
+  static final _readData = _library
+      .lookupFunction<_ReadDataNative, _ReadData>('rich_clipboard_read_data');
+  static final _finalizer = NativeFinalizer(_library
+      .lookup<NativeFunction<Void Function(Pointer<Void>)>>(
+          'rich_clipboard_free_data'));
+
+  /// Reads the raw bytes of [type] from the system clipboard.
+  ///
+  /// [type] may be any of the types reported by `getAvailableTypes`, or
+  /// `text/plain`, which is returned as UTF-8, just like `getBinaryData`.
+  /// Returns null if the clipboard does not hold [type], and throws a
+  /// [TimeoutException] if the transfer takes longer than 30 seconds.
+  ///
+  /// The returned list views native memory that is freed once the list is
+  /// garbage collected.
+  static Uint8List? readData(String type) {
+    return using((arena) {
+      final data = arena<Pointer<Uint8>>();
+      final length = arena<IntPtr>();
+      final result = _readData(
+        type.toNativeUtf8(allocator: arena),
+        data,
+        length,
+      );
+      if (result == _kReadNoPlugin) {
+        throw StateError('The rich_clipboard plugin is not registered.');
+      }
+      if (result == _kReadTimedOut) {
+        throw TimeoutException('Timed out reading $type from the clipboard.');
+      }
+      if (result != _kReadOk) {
+        return null;
+      }
+
+      final bytes = data.value.asTypedList(length.value);
+      _finalizer.attach(
+        bytes,
+        data.value.cast(),
+        externalSize: length.value,
+      );
+      return bytes;
+    });
+  }
+}
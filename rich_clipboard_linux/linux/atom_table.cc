@@ -0,0 +1,48 @@
+#include "atom_table.h"
+
+using namespace std;
+
+AtomTable::~AtomTable()
+{
+  for (auto &name : names)
+  {
+    fl_value_unref(name.second.value);
+  }
+}
+
+const AtomTable::Name &AtomTable::lookup(GdkAtom atom)
+{
+  auto name = names.find(atom);
+  if (name == names.end())
+  {
+    g_autofree gchar *atomName = gdk_atom_name(atom);
+    name = names.emplace(atom, Name{atomName, fl_value_new_string(atomName)}).first;
+    atoms.emplace(atomName, atom);
+  }
+  return name->second;
+}
+
+const string &AtomTable::getName(GdkAtom atom)
+{
+  return lookup(atom).name;
+}
+
+GdkAtom AtomTable::intern(const string &name)
+{
+  auto atom = atoms.find(name);
+  if (atom != atoms.end())
+  {
+    return atom->second;
+  }
+  return atoms.emplace(name, gdk_atom_intern(name.c_str(), FALSE)).first->second;
+}
+
+FlValue *AtomTable::newTypesValue(const GdkAtom *targets, gint numTargets)
+{
+  auto *types = fl_value_new_list();
+  for (gint i = 0; i < numTargets; i++)
+  {
+    fl_value_append(types, lookup(targets[i]).value);
+  }
+  return types;
+}
@@ -0,0 +1,45 @@
+#ifndef RICH_CLIPBOARD_LINUX_ATOM_TABLE_H_
+#define RICH_CLIPBOARD_LINUX_ATOM_TABLE_H_
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+
+#include <map>
+#include <string>
+
+// The names of the targets clipboard owners advertise, looked up once per
+// atom.
+//
+// Owners advertise the same few dozen targets over and over, so each name is
+// kept for the life of the plugin, along with the FlValue getAvailableTypes
+// reports it in. Listing or matching targets then costs no round trip to GDK
+// and no allocation per target. It is only used on the main thread.
+class AtomTable
+{
+private:
+  struct Name
+  {
+    std::string name;
+    FlValue *value;
+  };
+
+  std::map<GdkAtom, Name> names;
+  std::map<std::string, GdkAtom> atoms;
+
+  const Name &lookup(GdkAtom atom);
+
+public:
+  AtomTable() = default;
+  ~AtomTable();
+  AtomTable(const AtomTable &) = delete;
+  AtomTable &operator=(const AtomTable &) = delete;
+
+  const std::string &getName(GdkAtom atom);
+  // Returns the atom named name, interning it the first time.
+  GdkAtom intern(const std::string &name);
+  // Builds the list of target names getAvailableTypes reports. The list
+  // shares the names with the table rather than copying them.
+  FlValue *newTypesValue(const GdkAtom *targets, gint numTargets);
+};
+
+#endif  // RICH_CLIPBOARD_LINUX_ATOM_TABLE_H_
@@ -0,0 +1,38 @@
+#ifndef RICH_CLIPBOARD_LINUX_BENCHMARK_PAYLOAD_H_
+#define RICH_CLIPBOARD_LINUX_BENCHMARK_PAYLOAD_H_
+
+#include <glib.h>
+
+#include <string>
+
+// Builds a payload of exactly size bytes of plain text, or of HTML made of
+// paragraphs of that text, so the owner and the benchmark agree on it.
+inline std::string make_benchmark_payload(bool html, gsize size)
+{
+  static const char kLine[] = "The quick brown fox jumps over the lazy dog. ";
+  static const char kOpen[] = "<p>";
+  static const char kClose[] = "</p>\n";
+
+  std::string payload;
+  payload.reserve(size);
+  while (payload.size() < size)
+  {
+    if (html)
+    {
+      payload += kOpen;
+      for (int i = 0; i < 8; i++)
+      {
+        payload += kLine;
+      }
+      payload += kClose;
+    }
+    else
+    {
+      payload += kLine;
+    }
+  }
+  payload.resize(size);
+  return payload;
+}
+
+#endif  // RICH_CLIPBOARD_LINUX_BENCHMARK_PAYLOAD_H_
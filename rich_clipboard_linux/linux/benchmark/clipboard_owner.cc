@@ -0,0 +1,110 @@
+// A separate process that owns the CLIPBOARD selection for the benchmark, the
+// way another application would.
+//
+// It reads commands from stdin, one per line:
+//
+//   claim <plain|html> <bytes>  takes ownership with a payload of that size,
+//                               then prints "ready"
+//   quit                        exits
+#include <gtk/gtk.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "benchmark_payload.h"
+
+using namespace std;
+
+enum
+{
+  kInfoText = 1,
+  kInfoHtml = 2,
+};
+
+static string payload;
+
+static void gtk_clipboard_get_callback(
+    GtkClipboard *clipboard,
+    GtkSelectionData *selectionData,
+    guint info,
+    gpointer user_data)
+{
+  auto *data = reinterpret_cast<const guchar *>(payload.data());
+  if (info == kInfoText)
+  {
+    gtk_selection_data_set_text(selectionData, payload.data(), payload.size());
+  }
+  else
+  {
+    gtk_selection_data_set(selectionData, gtk_selection_data_get_target(selectionData), 8, data, payload.size());
+  }
+}
+
+static void gtk_clipboard_clear_callback(GtkClipboard *clipboard, gpointer user_data) {}
+
+static void claim(const char *kind, gsize size)
+{
+  bool html = strcmp(kind, "html") == 0;
+  payload = make_benchmark_payload(html, size);
+
+  auto *targetList = gtk_target_list_new(nullptr, 0);
+  if (html)
+  {
+    gtk_target_list_add(targetList, gdk_atom_intern_static_string("text/html"), 0, kInfoHtml);
+  }
+  else
+  {
+    gtk_target_list_add_text_targets(targetList, kInfoText);
+  }
+  gint numTargets;
+  auto *targetTable = gtk_target_table_new_from_list(targetList, &numTargets);
+  gtk_target_list_unref(targetList);
+
+  auto *clipboard = gtk_clipboard_get_default(gdk_display_get_default());
+  gtk_clipboard_set_with_data(
+      clipboard,
+      targetTable,
+      numTargets,
+      gtk_clipboard_get_callback,
+      gtk_clipboard_clear_callback,
+      nullptr);
+  gtk_target_table_free(targetTable, numTargets);
+}
+
+static gboolean stdin_cb(GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+  g_autofree gchar *line = nullptr;
+  if (g_io_channel_read_line(channel, &line, nullptr, nullptr, nullptr) != G_IO_STATUS_NORMAL)
+  {
+    gtk_main_quit();
+    return G_SOURCE_REMOVE;
+  }
+
+  char kind[16];
+  gsize size;
+  if (sscanf(line, "claim %15s %zu", kind, &size) == 2)
+  {
+    claim(kind, size);
+    // Make sure the X server has processed the claim before the benchmark
+    // starts timing reads.
+    gdk_display_sync(gdk_display_get_default());
+    printf("ready\n");
+    fflush(stdout);
+    return G_SOURCE_CONTINUE;
+  }
+
+  gtk_main_quit();
+  return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char **argv)
+{
+  gtk_init(&argc, &argv);
+
+  auto *channel = g_io_channel_unix_new(fileno(stdin));
+  g_io_add_watch(channel, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP), stdin_cb, nullptr);
+  gtk_main();
+  g_io_channel_unref(channel);
+  return 0;
+}
@@ -0,0 +1,607 @@
+// Measures the plugin's getData, getAvailableTypes, hasTypes and setData
+// handling
+// against a real X display, with the clipboard owned by a separate process,
+// against a Wayland compositor through ext-data-control, with the clipboard
+// owned by a second connection, or against an in-memory clipboard with a
+// simulated latency and bandwidth.
+//
+// The plugin is registered with a stand-in for the engine's messenger, so each
+// call goes through the same codec and method dispatch as one from Dart, just
+// without a Dart isolate on the other end. Run it on a virtual display with
+// run_benchmarks.sh.
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../memory_clipboard_backend.h"
+#include "../rich_clipboard_linux_plugin_private.h"
+#ifdef RICH_CLIPBOARD_LINUX_WAYLAND
+#include "../wayland_clipboard_backend.h"
+#endif
+#include "benchmark_payload.h"
+
+using namespace std;
+
+const char kChannelName[] = "com.bringingfire.rich_clipboard";
+const char kMimeTextPlain[] = "text/plain";
+const char kMimeTextHtml[] = "text/html";
+
+const gsize kPayloadSizes[] = {
+    1 << 10,
+    64 << 10,
+    1 << 20,
+    16 << 20,
+    200 << 20,
+};
+
+// A message handler the plugin registered on a channel.
+struct ChannelHandler
+{
+  FlBinaryMessengerMessageHandler handler;
+  gpointer userData;
+  GDestroyNotify destroyNotify;
+};
+
+static void channel_handler_free(gpointer data)
+{
+  auto *handler = static_cast<ChannelHandler *>(data);
+  if (handler->destroyNotify != nullptr)
+  {
+    handler->destroyNotify(handler->userData);
+  }
+  delete handler;
+}
+
+// Collects the plugin's answer to one method call.
+G_DECLARE_FINAL_TYPE(BenchResponseHandle, bench_response_handle, BENCH, RESPONSE_HANDLE,
+                     FlBinaryMessengerResponseHandle)
+
+struct _BenchResponseHandle
+{
+  FlBinaryMessengerResponseHandle parent_instance;
+
+  GBytes *response;
+  gboolean done;
+};
+
+G_DEFINE_TYPE(BenchResponseHandle, bench_response_handle, fl_binary_messenger_response_handle_get_type())
+
+static void bench_response_handle_dispose(GObject *object)
+{
+  auto *self = BENCH_RESPONSE_HANDLE(object);
+  g_clear_pointer(&self->response, g_bytes_unref);
+  G_OBJECT_CLASS(bench_response_handle_parent_class)->dispose(object);
+}
+
+static void bench_response_handle_class_init(BenchResponseHandleClass *klass)
+{
+  G_OBJECT_CLASS(klass)->dispose = bench_response_handle_dispose;
+}
+
+static void bench_response_handle_init(BenchResponseHandle *self) {}
+
+// Stands in for the engine's messenger. It keeps the handlers the plugin
+// registers, and calls to Dart fail right away.
+G_DECLARE_FINAL_TYPE(BenchMessenger, bench_messenger, BENCH, MESSENGER, GObject)
+
+struct _BenchMessenger
+{
+  GObject parent_instance;
+
+  GHashTable *handlers;
+};
+
+static void bench_messenger_iface_init(FlBinaryMessengerInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(BenchMessenger, bench_messenger, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(fl_binary_messenger_get_type(), bench_messenger_iface_init))
+
+static void bench_messenger_set_message_handler_on_channel(
+    FlBinaryMessenger *messenger,
+    const gchar *channel,
+    FlBinaryMessengerMessageHandler handler,
+    gpointer user_data,
+    GDestroyNotify destroy_notify)
+{
+  auto *self = BENCH_MESSENGER(messenger);
+  if (handler == nullptr)
+  {
+    g_hash_table_remove(self->handlers, channel);
+    return;
+  }
+  g_hash_table_replace(self->handlers, g_strdup(channel), new ChannelHandler{handler, user_data, destroy_notify});
+}
+
+static gboolean bench_messenger_send_response(
+    FlBinaryMessenger *messenger,
+    FlBinaryMessengerResponseHandle *response_handle,
+    GBytes *response,
+    GError **error)
+{
+  auto *handle = BENCH_RESPONSE_HANDLE(response_handle);
+  handle->response = response != nullptr ? g_bytes_ref(response) : nullptr;
+  handle->done = TRUE;
+  return TRUE;
+}
+
+static void bench_messenger_send_on_channel(
+    FlBinaryMessenger *messenger,
+    const gchar *channel,
+    GBytes *message,
+    GCancellable *cancellable,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  g_autoptr(GTask) task = g_task_new(messenger, cancellable, callback, user_data);
+  g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "There is no Dart side to call");
+}
+
+static GBytes *bench_messenger_send_on_channel_finish(
+    FlBinaryMessenger *messenger,
+    GAsyncResult *result,
+    GError **error)
+{
+  return static_cast<GBytes *>(g_task_propagate_pointer(G_TASK(result), error));
+}
+
+static void bench_messenger_iface_init(FlBinaryMessengerInterface *iface)
+{
+  iface->set_message_handler_on_channel = bench_messenger_set_message_handler_on_channel;
+  iface->send_response = bench_messenger_send_response;
+  iface->send_on_channel = bench_messenger_send_on_channel;
+  iface->send_on_channel_finish = bench_messenger_send_on_channel_finish;
+}
+
+static void bench_messenger_dispose(GObject *object)
+{
+  auto *self = BENCH_MESSENGER(object);
+  g_clear_pointer(&self->handlers, g_hash_table_unref);
+  G_OBJECT_CLASS(bench_messenger_parent_class)->dispose(object);
+}
+
+static void bench_messenger_class_init(BenchMessengerClass *klass)
+{
+  G_OBJECT_CLASS(klass)->dispose = bench_messenger_dispose;
+}
+
+static void bench_messenger_init(BenchMessenger *self)
+{
+  self->handlers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, channel_handler_free);
+}
+
+// Hands the plugin the stand-in messenger.
+G_DECLARE_FINAL_TYPE(BenchRegistrar, bench_registrar, BENCH, REGISTRAR, GObject)
+
+struct _BenchRegistrar
+{
+  GObject parent_instance;
+
+  BenchMessenger *messenger;
+};
+
+static void bench_registrar_iface_init(FlPluginRegistrarInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(BenchRegistrar, bench_registrar, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(fl_plugin_registrar_get_type(), bench_registrar_iface_init))
+
+static FlBinaryMessenger *bench_registrar_get_messenger(FlPluginRegistrar *registrar)
+{
+  return FL_BINARY_MESSENGER(BENCH_REGISTRAR(registrar)->messenger);
+}
+
+static FlTextureRegistrar *bench_registrar_get_texture_registrar(FlPluginRegistrar *registrar)
+{
+  return nullptr;
+}
+
+static FlView *bench_registrar_get_view(FlPluginRegistrar *registrar)
+{
+  return nullptr;
+}
+
+static void bench_registrar_iface_init(FlPluginRegistrarInterface *iface)
+{
+  iface->get_messenger = bench_registrar_get_messenger;
+  iface->get_texture_registrar = bench_registrar_get_texture_registrar;
+  iface->get_view = bench_registrar_get_view;
+}
+
+static void bench_registrar_dispose(GObject *object)
+{
+  auto *self = BENCH_REGISTRAR(object);
+  g_clear_object(&self->messenger);
+  G_OBJECT_CLASS(bench_registrar_parent_class)->dispose(object);
+}
+
+static void bench_registrar_class_init(BenchRegistrarClass *klass)
+{
+  G_OBJECT_CLASS(klass)->dispose = bench_registrar_dispose;
+}
+
+static void bench_registrar_init(BenchRegistrar *self)
+{
+  self->messenger = BENCH_MESSENGER(g_object_new(bench_messenger_get_type(), nullptr));
+}
+
+// Calls a plugin method the way the engine delivers a call from Dart, and
+// runs the main loop until it is answered. Returns the result, or exits if
+// the call failed.
+static FlValue *invoke_method(BenchMessenger *messenger, const gchar *method, FlValue *args)
+{
+  auto *handler = static_cast<ChannelHandler *>(g_hash_table_lookup(messenger->handlers, kChannelName));
+  g_assert(handler != nullptr);
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(GBytes) message = fl_method_codec_encode_method_call(FL_METHOD_CODEC(codec), method, args, &error);
+  g_assert_no_error(error);
+
+  g_autoptr(BenchResponseHandle) handle =
+      BENCH_RESPONSE_HANDLE(g_object_new(bench_response_handle_get_type(), nullptr));
+  handler->handler(
+      FL_BINARY_MESSENGER(messenger),
+      kChannelName,
+      message,
+      FL_BINARY_MESSENGER_RESPONSE_HANDLE(handle),
+      handler->userData);
+  while (!handle->done)
+  {
+    g_main_context_iteration(nullptr, TRUE);
+  }
+
+  g_autoptr(FlMethodResponse) response = fl_method_codec_decode_response(FL_METHOD_CODEC(codec), handle->response, &error);
+  g_assert_no_error(error);
+  auto *result = fl_method_response_get_result(response, &error);
+  if (result == nullptr)
+  {
+    g_printerr("%s failed: %s\n", method, error->message);
+    exit(1);
+  }
+  return fl_value_ref(result);
+}
+
+// The owner process, driven over its stdin and stdout.
+class OwnerProcess
+{
+private:
+  GPid pid;
+  FILE *commands;
+  FILE *replies;
+
+public:
+  explicit OwnerProcess(const gchar *path)
+  {
+    const gchar *argv[] = {path, nullptr};
+    gint stdinFd;
+    gint stdoutFd;
+    g_autoptr(GError) error = nullptr;
+    if (!g_spawn_async_with_pipes(
+            nullptr,
+            const_cast<gchar **>(argv),
+            nullptr,
+            G_SPAWN_DO_NOT_REAP_CHILD,
+            nullptr,
+            nullptr,
+            &pid,
+            &stdinFd,
+            &stdoutFd,
+            nullptr,
+            &error))
+    {
+      g_printerr("Failed to start %s: %s\n", path, error->message);
+      exit(1);
+    }
+    commands = fdopen(stdinFd, "w");
+    replies = fdopen(stdoutFd, "r");
+  }
+  ~OwnerProcess()
+  {
+    fprintf(commands, "quit\n");
+    fclose(commands);
+    fclose(replies);
+    waitpid(pid, nullptr, 0);
+    g_spawn_close_pid(pid);
+  }
+  OwnerProcess(const OwnerProcess &) = delete;
+  OwnerProcess &operator=(const OwnerProcess &) = delete;
+
+  // Makes the owner take the clipboard with a fresh payload.
+  void claim(bool html, gsize size)
+  {
+    fprintf(commands, "claim %s %" G_GSIZE_FORMAT "\n", html ? "html" : "plain", size);
+    fflush(commands);
+    char reply[16];
+    if (fgets(reply, sizeof(reply), replies) == nullptr || strcmp(reply, "ready\n") != 0)
+    {
+      g_printerr("The owner process did not take the clipboard\n");
+      exit(1);
+    }
+  }
+};
+
+static guint ownerChanges = 0;
+static bool reportsOwnerChanges = true;
+
+static void owner_change_cb(GtkClipboard *clipboard, GdkEvent *event, gpointer user_data)
+{
+  ownerChanges++;
+}
+
+// Counts the owner changes Backend reports to the plugin.
+template <typename Backend>
+class CountingBackend : public Backend
+{
+public:
+  using Backend::Backend;
+
+  void setOwnerChangeCallback(ClipboardBackend::OwnerChangeCallback callback) override
+  {
+    Backend::setOwnerChangeCallback(
+        [callback](guint32 selectionTime)
+        {
+          ownerChanges++;
+          callback(selectionTime);
+        });
+  }
+};
+
+#ifdef RICH_CLIPBOARD_LINUX_WAYLAND
+// Serves the payload of the second Wayland connection, which stands in for
+// another application.
+class PayloadSource : public ClipboardSource
+{
+public:
+  string payload;
+  bool text = false;
+
+  void get(guint info, const Writer &write) override
+  {
+    write(reinterpret_cast<const guchar *>(payload.data()), payload.size(), text, nullptr);
+  }
+  void clear() override {}
+};
+#endif
+
+// Gives the clipboard to another owner with a fresh payload.
+using ClaimFunction = function<void(bool html, gsize size)>;
+
+// Has the owner take the clipboard again, and waits until the plugin has
+// seen the owner change, so the next read cannot come from its snapshot.
+static void reclaim(const ClaimFunction &claim, bool html, gsize size)
+{
+  auto seen = ownerChanges;
+  claim(html, size);
+  if (reportsOwnerChanges)
+  {
+    while (ownerChanges == seen)
+    {
+      g_main_context_iteration(nullptr, TRUE);
+    }
+  }
+}
+
+static gint64 peak_rss_kib()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// Times iterations runs of operation, after setup has run before each one,
+// and prints the percentiles, throughput and peak RSS.
+static void run_case(
+    const char *name,
+    bool html,
+    gsize size,
+    int iterations,
+    const function<void()> &setup,
+    const function<void()> &operation)
+{
+  vector<double> millis;
+  for (int i = 0; i < iterations; i++)
+  {
+    setup();
+    auto start = g_get_monotonic_time();
+    operation();
+    millis.push_back((g_get_monotonic_time() - start) / 1000.0);
+  }
+  sort(millis.begin(), millis.end());
+
+  auto percentile = [&millis](double p)
+  {
+    auto index = static_cast<size_t>(ceil(p * millis.size()));
+    return millis[index > 0 ? index - 1 : 0];
+  };
+  auto p50 = percentile(0.5);
+  auto p99 = percentile(0.99);
+  auto throughput = p50 > 0 ? size / (p50 / 1000.0) / (1 << 20) : 0;
+  printf("%-24s %-5s %10" G_GSIZE_FORMAT " %5d %10.3f %10.3f %10.1f %10.1f\n",
+         name, html ? "html" : "plain", size, iterations, p50, p99, throughput,
+         peak_rss_kib() / 1024.0);
+  fflush(stdout);
+}
+
+// Fewer runs for the larger payloads, so they take a bounded amount of time.
+static int iterations_for(gsize size, int iterations)
+{
+  auto scaled = static_cast<gint64>(iterations) * (1 << 20) / static_cast<gint64>(size);
+  return static_cast<int>(CLAMP(scaled, 3, iterations));
+}
+
+static gint iterations = 50;
+static gint64 maxSize = 200 << 20;
+static gchar *ownerPath = nullptr;
+static gchar *backendName = nullptr;
+static gint latencyUs = 0;
+static gint64 bandwidth = 0;
+
+static GOptionEntry entries[] = {
+    {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations, "Runs per case for payloads up to 1 MiB", "N"},
+    {"max-size", 's', 0, G_OPTION_ARG_INT64, &maxSize, "Skip payloads larger than this many bytes", "BYTES"},
+    {"owner", 'o', 0, G_OPTION_ARG_FILENAME, &ownerPath, "Path of the owner process", "PATH"},
+    {"backend", 'b', 0, G_OPTION_ARG_STRING, &backendName, "The clipboard to run against, gtk, memory or wayland", "NAME"},
+    {"latency-us", 0, 0, G_OPTION_ARG_INT, &latencyUs, "Latency of each memory clipboard transfer", "US"},
+    {"bandwidth", 0, 0, G_OPTION_ARG_INT64, &bandwidth, "Bytes per second of memory clipboard transfers", "BYTES"},
+    {nullptr},
+};
+
+int main(int argc, char **argv)
+{
+  g_autoptr(GOptionContext) context = g_option_context_new("- benchmark the Linux clipboard plugin");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_option_context_add_group(context, gtk_get_option_group(FALSE));
+  g_autoptr(GError) error = nullptr;
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+
+  g_autoptr(BenchRegistrar) registrar = BENCH_REGISTRAR(g_object_new(bench_registrar_get_type(), nullptr));
+  auto *messenger = registrar->messenger;
+  g_autoptr(FlRichClipboardPlugin) plugin = nullptr;
+  unique_ptr<OwnerProcess> owner;
+#ifdef RICH_CLIPBOARD_LINUX_WAYLAND
+  unique_ptr<PayloadSource> payloadSource;
+  unique_ptr<WaylandClipboardBackend> ownerBackend;
+#endif
+  ClaimFunction claim;
+
+  if (g_strcmp0(backendName, "memory") == 0)
+  {
+    // Needs no display, so the timings do not depend on an X server.
+    auto *backend = new CountingBackend<MemoryClipboardBackend>(latencyUs, bandwidth);
+    plugin = fl_rich_clipboard_plugin_new_with_backend(FL_PLUGIN_REGISTRAR(registrar), backend);
+    claim = [backend](bool html, gsize size)
+    {
+      auto target = gdk_atom_intern_static_string(html ? kMimeTextHtml : "UTF8_STRING");
+      backend->setForeignData(GDK_SELECTION_CLIPBOARD, {{target, make_benchmark_payload(html, size)}});
+    };
+  }
+#ifdef RICH_CLIPBOARD_LINUX_WAYLAND
+  else if (g_strcmp0(backendName, "wayland") == 0)
+  {
+    // Run it under a headless compositor that supports ext-data-control,
+    // e.g. sway with WLR_BACKENDS=headless.
+    auto *backend = new CountingBackend<WaylandClipboardBackend>();
+    ownerBackend.reset(new WaylandClipboardBackend());
+    if (!backend->isConnected() || !ownerBackend->isConnected())
+    {
+      g_printerr("Cannot reach a Wayland compositor that supports ext-data-control\n");
+      delete backend;
+      return 1;
+    }
+    plugin = fl_rich_clipboard_plugin_new_with_backend(FL_PLUGIN_REGISTRAR(registrar), backend);
+
+    payloadSource.reset(new PayloadSource());
+    auto *source = payloadSource.get();
+    auto *ownerClipboard = ownerBackend.get();
+    claim = [source, ownerClipboard](bool html, gsize size)
+    {
+      static const GtkTargetEntry kHtmlTargets[] = {{const_cast<gchar *>(kMimeTextHtml), 0, 0}};
+      static const GtkTargetEntry kTextTargets[] = {
+          {const_cast<gchar *>("text/plain;charset=utf-8"), 0, 0},
+          {const_cast<gchar *>("UTF8_STRING"), 0, 0},
+      };
+      source->payload = make_benchmark_payload(html, size);
+      source->text = !html;
+      ownerClipboard->setData(
+          GDK_SELECTION_CLIPBOARD,
+          html ? kHtmlTargets : kTextTargets,
+          html ? G_N_ELEMENTS(kHtmlTargets) : G_N_ELEMENTS(kTextTargets),
+          source);
+    };
+  }
+#endif
+  else if (backendName == nullptr || strcmp(backendName, "gtk") == 0)
+  {
+    if (!gtk_init_check(&argc, &argv))
+    {
+      g_printerr("Cannot open the display\n");
+      return 1;
+    }
+
+    g_autofree gchar *defaultOwnerPath = nullptr;
+    if (ownerPath == nullptr)
+    {
+      g_autofree gchar *executable = g_file_read_link("/proc/self/exe", nullptr);
+      g_autofree gchar *directory = g_path_get_dirname(executable != nullptr ? executable : argv[0]);
+      defaultOwnerPath = g_build_filename(directory, "rich_clipboard_benchmark_owner", nullptr);
+    }
+
+    reportsOwnerChanges = gdk_display_supports_selection_notification(gdk_display_get_default());
+    if (!reportsOwnerChanges)
+    {
+      g_printerr("The display does not report owner changes, so cold reads may be served from the snapshot\n");
+    }
+    g_signal_connect(gtk_clipboard_get_default(gdk_display_get_default()), "owner-change",
+                     G_CALLBACK(owner_change_cb), nullptr);
+
+    plugin = fl_rich_clipboard_plugin_new(FL_PLUGIN_REGISTRAR(registrar));
+    owner.reset(new OwnerProcess(ownerPath != nullptr ? ownerPath : defaultOwnerPath));
+    auto *ownerProcess = owner.get();
+    claim = [ownerProcess](bool html, gsize size)
+    {
+      ownerProcess->claim(html, size);
+    };
+  }
+  else
+  {
+    g_printerr("Unknown backend %s\n", backendName);
+    return 1;
+  }
+
+  printf("%-24s %-5s %10s %5s %10s %10s %10s %10s\n",
+         "case", "kind", "bytes", "runs", "p50 ms", "p99 ms", "MiB/s", "peak MiB");
+  for (auto html : {false, true})
+  {
+    auto *mimeType = html ? kMimeTextHtml : kMimeTextPlain;
+    g_autoptr(FlValue) types = fl_value_new_list();
+    fl_value_append_take(types, fl_value_new_string(mimeType));
+
+    for (auto size : kPayloadSizes)
+    {
+      if (static_cast<gint64>(size) > maxSize)
+      {
+        continue;
+      }
+      auto runs = iterations_for(size, iterations);
+
+      auto read = [&]()
+      {
+        g_autoptr(FlValue) result = invoke_method(messenger, "getData", types);
+        auto *value = fl_value_lookup_string(result, mimeType);
+        if (value == nullptr || strlen(fl_value_get_string(value)) != size)
+        {
+          g_printerr("getData returned the wrong payload for %s\n", mimeType);
+          exit(1);
+        }
+      };
+      run_case("getData", html, size, runs, [&]() { reclaim(claim, html, size); }, read);
+      run_case("getData (snapshot)", html, size, runs, []() {}, read);
+
+      run_case("getAvailableTypes", html, size, runs, [&]() { reclaim(claim, html, size); },
+               [&]() { fl_value_unref(invoke_method(messenger, "getAvailableTypes", nullptr)); });
+      run_case("hasTypes", html, size, runs, [&]() { reclaim(claim, html, size); },
+               [&]() { fl_value_unref(invoke_method(messenger, "hasTypes", types)); });
+
+      g_autoptr(FlValue) data = fl_value_new_map();
+      fl_value_set_string_take(data, mimeType, fl_value_new_string(make_benchmark_payload(html, size).c_str()));
+      run_case("setData", html, size, runs, []() {},
+               [&]() { fl_value_unref(invoke_method(messenger, "setData", data)); });
+    }
+  }
+
+  return 0;
+}
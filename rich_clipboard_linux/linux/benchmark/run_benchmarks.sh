@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+# Builds the native benchmarks of the Linux plugin through the example app and
+# runs them on a virtual X display.
+#
+# Needs flutter and xvfb-run on the PATH. Arguments are passed on to the
+# benchmark, for example --max-size=16777216 to skip the largest payloads.
+set -euo pipefail
+
+root="$(cd "$(dirname "${BASH_SOURCE[0]}")/../../.." && pwd)"
+example="${root}/rich_clipboard/example"
+build="${example}/build/linux/x64/release"
+
+# Generates the Flutter build files the plugin's CMake project relies on.
+(cd "${example}" && flutter build linux --release)
+
+cmake -S "${example}/linux" -B "${build}" -DRICH_CLIPBOARD_LINUX_BENCHMARKS=ON
+cmake --build "${build}" --target rich_clipboard_benchmark
+
+xvfb-run -a -s "-screen 0 1280x1024x24" \
+  "${build}/plugins/rich_clipboard_linux/benchmark/rich_clipboard_benchmark" "$@"
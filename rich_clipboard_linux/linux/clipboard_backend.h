@@ -0,0 +1,90 @@
+#ifndef RICH_CLIPBOARD_LINUX_CLIPBOARD_BACKEND_H_
+#define RICH_CLIPBOARD_LINUX_CLIPBOARD_BACKEND_H_
+
+#include <gtk/gtk.h>
+
+#include <functional>
+#include <vector>
+
+// How a handoff to the clipboard manager ended.
+enum StoreOutcome
+{
+  kStoreOutcomeStored,
+  // There is no manager, it refused the data, or a later handoff replaced
+  // this one.
+  kStoreOutcomeFailed,
+  kStoreOutcomeTimedOut,
+};
+
+// Serves the formats of data the plugin put on a selection.
+class ClipboardSource
+{
+public:
+  // Receives the bytes of a format. text is set for UTF-8 text, which the
+  // backend may convert for the text target that was asked for. bytes holds
+  // data for backends that write it after the call returns, or is null if
+  // data only lives as long as the call.
+  using Writer = std::function<void(const guchar *data, gsize length, bool text, GBytes *bytes)>;
+
+  virtual ~ClipboardSource() = default;
+
+  // Calls write with the bytes of the format registered with info, unless
+  // there are none. This may run the main loop to render promised data.
+  virtual void get(guint info, const Writer &write) = 0;
+  // Called once the backend no longer needs the source, because the
+  // selection was cleared or taken over.
+  virtual void clear() = 0;
+};
+
+// The clipboard the plugin talks to. Selections are identified by their
+// atom, GDK_SELECTION_CLIPBOARD or GDK_SELECTION_PRIMARY.
+//
+// Callbacks of a request may run before the request returns, e.g. when the
+// backend can answer it without a round trip.
+class ClipboardBackend
+{
+public:
+  using TargetsCallback = std::function<void(const GdkAtom *atoms, gint numAtoms)>;
+  // data is null if the target could not be read. It is only valid during the
+  // call, unless the callback keeps bytes, which holds it. bytes is null if
+  // the backend has nothing to hand over without a copy.
+  using ContentsCallback = std::function<void(const guchar *data, gsize length, GBytes *bytes)>;
+  // selectionTime is 0 if the backend has no timestamps for changes.
+  using OwnerChangeCallback = std::function<void(guint32 selectionTime)>;
+  using StoreCallback = std::function<void(StoreOutcome outcome)>;
+
+  virtual ~ClipboardBackend() = default;
+
+  // Whether owner changes of CLIPBOARD are reported reliably, so data read
+  // from another owner can be kept until the next change.
+  virtual bool reportsOwnerChanges() = 0;
+  // Sets the callback for owner changes of CLIPBOARD, including our own.
+  virtual void setOwnerChangeCallback(OwnerChangeCallback callback) = 0;
+
+  virtual void requestTargets(GdkAtom selection, TargetsCallback callback) = 0;
+  // Reads target from selection. With text set, the target is converted
+  // from whatever text encoding it uses to UTF-8.
+  virtual void requestContents(GdkAtom selection, GdkAtom target, bool text, ContentsCallback callback) = 0;
+
+  // Takes ownership of selection, offering targets. The source serves them
+  // until it is cleared.
+  virtual void setData(
+      GdkAtom selection,
+      const GtkTargetEntry *targets,
+      gint numTargets,
+      ClipboardSource *source) = 0;
+  // Gives up selection if we own it.
+  virtual void clear(GdkAtom selection) = 0;
+  // Leaves selection empty, whoever owns it.
+  virtual void empty(GdkAtom selection) = 0;
+
+  // Marks targets of the CLIPBOARD data we own to be handed to the clipboard
+  // manager when the application exits.
+  virtual void setCanStore(const GtkTargetEntry *targets, gint numTargets) = 0;
+  // Asks the clipboard manager to copy targets of the CLIPBOARD data we own
+  // right away, so it outlives us, and calls callback with the outcome. A
+  // store that is still running when another one starts fails.
+  virtual void store(const std::vector<GdkAtom> &targets, StoreCallback callback) = 0;
+};
+
+#endif  // RICH_CLIPBOARD_LINUX_CLIPBOARD_BACKEND_H_
@@ -0,0 +1,265 @@
+#include "clipboard_history.h"
+
+#include <gio/gio.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "content_hash.h"
+
+using namespace std;
+
+const char kMimeTextPlain[] = "text/plain";
+
+// How much of the plain text listings show.
+const gsize kPreviewLength = 120;
+
+// The fixed cost of a snapshot against the budget, on top of its block.
+const gsize kSnapshotOverhead = 128;
+
+// How much output a conversion step may produce at once.
+const gsize kConvertChunkLength = 64 * 1024;
+
+// Clipboard text compresses well even at the fastest level, which keeps
+// packing cheap for large copies.
+const int kCompressionLevel = 1;
+
+ClipboardHistory::Snapshot::~Snapshot()
+{
+  g_clear_pointer(&block, g_bytes_unref);
+}
+
+gsize ClipboardHistory::Snapshot::getSize() const
+{
+  gsize size = kSnapshotOverhead + preview.size() + g_bytes_get_size(block);
+  for (auto &format : formats)
+  {
+    size += format.mimeType.size();
+  }
+  return size;
+}
+
+// Runs the formats through converter as one stream, and returns the output,
+// or null if the converter failed.
+static GBytes *convert_all(GConverter *converter, const vector<ClipboardHistory::FormatView> &inputs)
+{
+  auto *output = g_byte_array_sized_new(kConvertChunkLength);
+  for (size_t i = 0; i < inputs.size(); i++)
+  {
+    bool last = i + 1 == inputs.size();
+    auto *data = inputs[i].data;
+    auto length = inputs[i].length;
+    while (length > 0 || last)
+    {
+      auto used = output->len;
+      g_byte_array_set_size(output, used + kConvertChunkLength);
+      gsize bytesRead = 0;
+      gsize bytesWritten = 0;
+      g_autoptr(GError) error = nullptr;
+      auto result = g_converter_convert(
+          converter, data, length, output->data + used, kConvertChunkLength,
+          last ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS, &bytesRead, &bytesWritten, &error);
+      g_byte_array_set_size(output, used + bytesWritten);
+      if (result == G_CONVERTER_ERROR)
+      {
+        g_warning("Failed to convert clipboard history: %s", error->message);
+        g_byte_array_unref(output);
+        return nullptr;
+      }
+      data += bytesRead;
+      length -= bytesRead;
+      if (result == G_CONVERTER_FINISHED)
+      {
+        return g_byte_array_free_to_bytes(output);
+      }
+    }
+  }
+  return g_byte_array_free_to_bytes(output);
+}
+
+unique_ptr<ClipboardHistory::Snapshot> ClipboardHistory::pack(const vector<FormatView> &formats)
+{
+  unique_ptr<Snapshot> snapshot(new Snapshot());
+
+  // The names and lengths of the formats are hashed along with their bytes,
+  // so the same bytes under other types differ.
+  string layout;
+  gsize total = 0;
+  for (auto &format : formats)
+  {
+    snapshot->formats.push_back({format.mimeType, format.length});
+    layout.append(format.mimeType.c_str(), format.mimeType.size() + 1);
+    layout.append(reinterpret_cast<const gchar *>(&format.length), sizeof(format.length));
+    total += format.length;
+
+    if (format.mimeType == kMimeTextPlain)
+    {
+      auto *text = reinterpret_cast<const gchar *>(format.data);
+      auto *end = text + MIN(format.length, kPreviewLength);
+      if (end < text + format.length)
+      {
+        // Do not cut a character in half.
+        while (end > text && (*end & 0xc0) == 0x80)
+        {
+          end--;
+        }
+      }
+      snapshot->preview.assign(text, end);
+    }
+  }
+  auto hash = content_hash(layout.data(), layout.size());
+  for (auto &format : formats)
+  {
+    hash = content_hash(format.data, format.length, hash);
+  }
+  snapshot->hash = hash;
+
+  // The formats are compressed as one stream straight from the caller's
+  // buffers, so they are only copied once.
+  vector<FormatView> inputs(formats);
+  if (inputs.empty())
+  {
+    inputs.push_back({"", nullptr, 0});
+  }
+  g_autoptr(GZlibCompressor) compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW, kCompressionLevel);
+  auto *compressed = convert_all(G_CONVERTER(compressor), inputs);
+  if (compressed != nullptr && g_bytes_get_size(compressed) < total)
+  {
+    snapshot->block = compressed;
+    snapshot->compressed = true;
+    return snapshot;
+  }
+
+  // Incompressible data, like text that is mostly emoji, is kept as it is.
+  if (compressed != nullptr)
+  {
+    g_bytes_unref(compressed);
+  }
+  auto *block = g_byte_array_sized_new(total);
+  for (auto &format : formats)
+  {
+    g_byte_array_append(block, format.data, format.length);
+  }
+  snapshot->block = g_byte_array_free_to_bytes(block);
+  return snapshot;
+}
+
+ClipboardHistory::ClipboardHistory(gsize maxBytes)
+    : maxBytes(maxBytes)
+{
+}
+
+void ClipboardHistory::evict()
+{
+  while (usedBytes > maxBytes && !entries.empty())
+  {
+    usedBytes -= entries.front()->getSize();
+    entries.pop_front();
+  }
+}
+
+void ClipboardHistory::setMaxBytes(gsize maxBytes)
+{
+  this->maxBytes = maxBytes;
+  evict();
+}
+
+void ClipboardHistory::add(unique_ptr<Snapshot> snapshot)
+{
+  auto duplicate = find_if(
+      entries.begin(), entries.end(),
+      [&snapshot](const shared_ptr<Snapshot> &entry)
+      {
+        return entry->hash == snapshot->hash;
+      });
+  if (duplicate != entries.end())
+  {
+    usedBytes -= (*duplicate)->getSize();
+    entries.erase(duplicate);
+  }
+
+  snapshot->id = ++lastId;
+  snapshot->timestamp = g_get_real_time() / 1000;
+  usedBytes += snapshot->getSize();
+  entries.push_back(move(snapshot));
+  evict();
+}
+
+void ClipboardHistory::clear()
+{
+  entries.clear();
+  usedBytes = 0;
+}
+
+FlValue *ClipboardHistory::listValue(guint64 beforeId, gsize limit)
+{
+  auto *list = fl_value_new_list();
+  for (auto entry = entries.rbegin(); entry != entries.rend() && fl_value_get_length(list) < limit; entry++)
+  {
+    auto &snapshot = *entry;
+    if (beforeId != 0 && snapshot->id >= beforeId)
+    {
+      continue;
+    }
+    auto *item = fl_value_new_map();
+    fl_value_set_string_take(item, "id", fl_value_new_int(snapshot->id));
+    fl_value_set_string_take(item, "timestamp", fl_value_new_int(snapshot->timestamp));
+    auto *types = fl_value_new_map();
+    for (auto &format : snapshot->formats)
+    {
+      fl_value_set_string_take(types, format.mimeType.c_str(), fl_value_new_int(format.length));
+    }
+    fl_value_set_string_take(item, "types", types);
+    if (!snapshot->preview.empty())
+    {
+      fl_value_set_string_take(
+          item, "preview", fl_value_new_string_sized(snapshot->preview.data(), snapshot->preview.size()));
+    }
+    fl_value_append_take(list, item);
+  }
+  return list;
+}
+
+shared_ptr<const ClipboardHistory::Snapshot> ClipboardHistory::find(guint64 id)
+{
+  auto entry = lower_bound(
+      entries.begin(), entries.end(), id,
+      [](const shared_ptr<Snapshot> &snapshot, guint64 id)
+      {
+        return snapshot->id < id;
+      });
+  if (entry == entries.end() || (*entry)->id != id)
+  {
+    return nullptr;
+  }
+  return *entry;
+}
+
+FlValue *ClipboardHistory::unpack(const Snapshot &snapshot)
+{
+  g_autoptr(GBytes) block = nullptr;
+  if (snapshot.compressed)
+  {
+    g_autoptr(GZlibDecompressor) decompressor = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW);
+    gsize length;
+    auto *data = static_cast<const guchar *>(g_bytes_get_data(snapshot.block, &length));
+    block = convert_all(G_CONVERTER(decompressor), {{"", data, length}});
+    if (block == nullptr)
+    {
+      return fl_value_new_null();
+    }
+  }
+  else
+  {
+    block = g_bytes_ref(snapshot.block);
+  }
+
+  auto *value = fl_value_new_map();
+  auto *data = static_cast<const gchar *>(g_bytes_get_data(block, nullptr));
+  for (auto &format : snapshot.formats)
+  {
+    fl_value_set_string_take(value, format.mimeType.c_str(), fl_value_new_string_sized(data, format.length));
+    data += format.length;
+  }
+  return value;
+}
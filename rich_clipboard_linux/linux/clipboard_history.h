@@ -0,0 +1,90 @@
+#ifndef RICH_CLIPBOARD_LINUX_CLIPBOARD_HISTORY_H_
+#define RICH_CLIPBOARD_LINUX_CLIPBOARD_HISTORY_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Past contents of the clipboard, kept in memory under a byte budget. Once
+// the snapshots exceed it, the oldest ones are dropped.
+//
+// Each snapshot packs its formats back to back into a single block, which is
+// compressed when that makes it smaller. Listing the history only touches
+// the metadata, and a snapshot is only unpacked when it is fetched.
+class ClipboardHistory
+{
+public:
+  // A format to capture, which stays owned by the caller during pack.
+  struct FormatView
+  {
+    std::string mimeType;
+    const guchar *data;
+    gsize length;
+  };
+
+  struct Snapshot
+  {
+    struct Format
+    {
+      std::string mimeType;
+      gsize length;
+    };
+
+    // Assigned when the snapshot is added.
+    guint64 id = 0;
+    gint64 timestamp = 0;
+
+    guint64 hash;
+    std::vector<Format> formats;
+    // The start of the plain text, if there is any.
+    std::string preview;
+    // The formats back to back, in the order of formats.
+    GBytes *block = nullptr;
+    bool compressed = false;
+
+    ~Snapshot();
+    // The bytes the snapshot counts against the budget.
+    gsize getSize() const;
+  };
+
+private:
+  gsize maxBytes;
+  gsize usedBytes = 0;
+  guint64 lastId = 0;
+  // Oldest first, so ids are ascending. Snapshots are shared with workers
+  // that unpack them, so eviction does not pull them from under a worker.
+  std::deque<std::shared_ptr<Snapshot>> entries;
+
+  void evict();
+
+public:
+  // Packs formats into a snapshot. This compresses them, so call it from a
+  // worker for large formats. It uses no state of the history.
+  static std::unique_ptr<Snapshot> pack(const std::vector<FormatView> &formats);
+
+  explicit ClipboardHistory(gsize maxBytes);
+  ClipboardHistory(const ClipboardHistory &) = delete;
+  ClipboardHistory &operator=(const ClipboardHistory &) = delete;
+
+  void setMaxBytes(gsize maxBytes);
+  // Adds snapshot as the newest entry. An older entry with the same content
+  // is dropped, so copying something again moves it to the top.
+  void add(std::unique_ptr<Snapshot> snapshot);
+  void clear();
+
+  // Lists up to limit entries, newest first, starting after the entry with
+  // id beforeId, or with the newest entry if beforeId is 0. Each entry is a
+  // map of its id, timestamp, the length of each format in types, and the
+  // preview if there is one.
+  FlValue *listValue(guint64 beforeId, gsize limit);
+  // Returns the entry with id, or null if it is no longer in the history.
+  std::shared_ptr<const Snapshot> find(guint64 id);
+  // Unpacks snapshot into a map of MIME type to string. Like pack, this uses
+  // no state of the history.
+  static FlValue *unpack(const Snapshot &snapshot);
+};
+
+#endif  // RICH_CLIPBOARD_LINUX_CLIPBOARD_HISTORY_H_
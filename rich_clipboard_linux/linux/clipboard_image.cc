@@ -0,0 +1,223 @@
+#include "clipboard_image.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const char kMimeImagePng[] = "image/png";
+
+// How much of the source the loader is fed at a time. Between steps it may
+// learn the size of the image, which is all an image that is returned as it
+// is needs.
+const gsize kLoadChunkLength = 64 * 1024;
+
+struct ImageFormat
+{
+  string name;
+  vector<string> mimeTypes;
+  bool writable;
+};
+
+// The formats of the installed GdkPixbuf loaders, looked up once.
+static const vector<ImageFormat> &get_image_formats()
+{
+  static const vector<ImageFormat> formats = []()
+  {
+    vector<ImageFormat> formats;
+    auto *list = gdk_pixbuf_get_formats();
+    for (auto *item = list; item != nullptr; item = item->next)
+    {
+      auto *pixbufFormat = static_cast<GdkPixbufFormat *>(item->data);
+      if (gdk_pixbuf_format_is_disabled(pixbufFormat))
+      {
+        continue;
+      }
+      ImageFormat format;
+      g_autofree gchar *name = gdk_pixbuf_format_get_name(pixbufFormat);
+      format.name = name;
+      format.writable = gdk_pixbuf_format_is_writable(pixbufFormat);
+      gchar **mimeTypes = gdk_pixbuf_format_get_mime_types(pixbufFormat);
+      for (auto **mimeType = mimeTypes; *mimeType != nullptr; mimeType++)
+      {
+        format.mimeTypes.push_back(*mimeType);
+      }
+      g_strfreev(mimeTypes);
+      formats.push_back(format);
+    }
+    g_slist_free(list);
+    return formats;
+  }();
+  return formats;
+}
+
+static const ImageFormat *find_image_format(const string &mimeType)
+{
+  for (auto &format : get_image_formats())
+  {
+    if (find(format.mimeTypes.begin(), format.mimeTypes.end(), mimeType) != format.mimeTypes.end())
+    {
+      return &format;
+    }
+  }
+  return nullptr;
+}
+
+vector<string> get_readable_image_types()
+{
+  vector<string> types = {kMimeImagePng};
+  for (auto &format : get_image_formats())
+  {
+    for (auto &mimeType : format.mimeTypes)
+    {
+      if (find(types.begin(), types.end(), mimeType) == types.end())
+      {
+        types.push_back(mimeType);
+      }
+    }
+  }
+  return types;
+}
+
+bool is_writable_image_type(const string &mimeType)
+{
+  auto *format = find_image_format(mimeType);
+  return format != nullptr && format->writable;
+}
+
+// The size of the image being loaded, and the size it is loaded at.
+struct LoadSize
+{
+  int maxWidth;
+  int maxHeight;
+  bool known = false;
+  int width = 0;
+  int height = 0;
+  bool scaled = false;
+};
+
+// Scales the image down to fit as it is decoded, which loaders like JPEG do
+// far more cheaply than scaling it afterwards.
+static void size_prepared_cb(GdkPixbufLoader *loader, gint width, gint height, gpointer user_data)
+{
+  auto *size = static_cast<LoadSize *>(user_data);
+  double scale = 1.0;
+  if (size->maxWidth > 0 && width > size->maxWidth)
+  {
+    scale = MIN(scale, static_cast<double>(size->maxWidth) / width);
+  }
+  if (size->maxHeight > 0 && height > size->maxHeight)
+  {
+    scale = MIN(scale, static_cast<double>(size->maxHeight) / height);
+  }
+  size->known = true;
+  size->scaled = scale < 1.0;
+  size->width = size->scaled ? MAX(1, static_cast<int>(lround(width * scale))) : width;
+  size->height = size->scaled ? MAX(1, static_cast<int>(lround(height * scale))) : height;
+  if (size->scaled)
+  {
+    gdk_pixbuf_loader_set_size(loader, size->width, size->height);
+  }
+}
+
+bool convert_image(
+    GBytes *source,
+    const string &sourceType,
+    const ImageOptions &options,
+    ConvertedImage &result,
+    GError **error)
+{
+  result.mimeType = options.mimeType.empty() ? sourceType : options.mimeType;
+  auto *format = find_image_format(result.mimeType);
+  if (options.mimeType.empty() && (format == nullptr || !format->writable))
+  {
+    result.mimeType = kMimeImagePng;
+    format = find_image_format(result.mimeType);
+  }
+  if (format == nullptr || !format->writable)
+  {
+    g_set_error(error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_UNKNOWN_TYPE, "Cannot encode %s", result.mimeType.c_str());
+    return false;
+  }
+
+  GdkPixbufLoader *loader = gdk_pixbuf_loader_new_with_mime_type(sourceType.c_str(), nullptr);
+  if (loader == nullptr)
+  {
+    // Let the loader tell the type from the data.
+    loader = gdk_pixbuf_loader_new();
+  }
+  LoadSize size{options.maxWidth, options.maxHeight};
+  g_signal_connect(loader, "size-prepared", G_CALLBACK(size_prepared_cb), &size);
+
+  gsize length;
+  auto *data = static_cast<const guchar *>(g_bytes_get_data(source, &length));
+  bool keep = result.mimeType == sourceType;
+  for (gsize offset = 0; offset < length; offset += kLoadChunkLength)
+  {
+    if (!gdk_pixbuf_loader_write(loader, data + offset, MIN(kLoadChunkLength, length - offset), error))
+    {
+      gdk_pixbuf_loader_close(loader, nullptr);
+      g_object_unref(loader);
+      return false;
+    }
+    if (keep && size.known && !size.scaled)
+    {
+      // The image is fine as it is, so the rest need not be decoded.
+      gdk_pixbuf_loader_close(loader, nullptr);
+      g_object_unref(loader);
+      result.width = size.width;
+      result.height = size.height;
+      result.bytes = g_bytes_ref(source);
+      return true;
+    }
+  }
+  if (!gdk_pixbuf_loader_close(loader, error))
+  {
+    g_object_unref(loader);
+    return false;
+  }
+
+  auto *pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+  if (pixbuf == nullptr)
+  {
+    g_object_unref(loader);
+    g_set_error(error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_CORRUPT_IMAGE, "The image is empty");
+    return false;
+  }
+  g_object_ref(pixbuf);
+  g_object_unref(loader);
+
+  // Loaders that cannot decode at a smaller size ignore the requested one.
+  if (size.scaled && (gdk_pixbuf_get_width(pixbuf) != size.width || gdk_pixbuf_get_height(pixbuf) != size.height))
+  {
+    auto *scaled = gdk_pixbuf_scale_simple(pixbuf, size.width, size.height, GDK_INTERP_BILINEAR);
+    g_object_unref(pixbuf);
+    pixbuf = scaled;
+  }
+  result.width = gdk_pixbuf_get_width(pixbuf);
+  result.height = gdk_pixbuf_get_height(pixbuf);
+
+  g_autofree gchar *quality = nullptr;
+  vector<gchar *> keys;
+  vector<gchar *> values;
+  if (format->name == "jpeg" && options.quality >= 0)
+  {
+    quality = g_strdup_printf("%d", MIN(options.quality, 100));
+    keys.push_back(const_cast<gchar *>("quality"));
+    values.push_back(quality);
+  }
+  keys.push_back(nullptr);
+  values.push_back(nullptr);
+
+  gchar *buffer;
+  gsize bufferLength;
+  auto saved = gdk_pixbuf_save_to_bufferv(
+      pixbuf, &buffer, &bufferLength, format->name.c_str(), keys.data(), values.data(), error);
+  g_object_unref(pixbuf);
+  if (!saved)
+  {
+    return false;
+  }
+  result.bytes = g_bytes_new_take(buffer, bufferLength);
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef RICH_CLIPBOARD_LINUX_CLIPBOARD_IMAGE_H_
+#define RICH_CLIPBOARD_LINUX_CLIPBOARD_IMAGE_H_
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <string>
+#include <vector>
+
+// The MIME type images are encoded in unless another one is asked for.
+extern const char kMimeImagePng[];
+
+// How convert_image turns a clipboard image into the one returned.
+struct ImageOptions
+{
+  // The largest size of the result, or 0 for no limit. Larger images are
+  // scaled down to fit, keeping their aspect ratio. Smaller ones are never
+  // scaled up.
+  int maxWidth = 0;
+  int maxHeight = 0;
+  // The MIME type to encode the result in, or empty to keep the type of the
+  // source, or PNG if that cannot be encoded.
+  std::string mimeType;
+  // The quality of JPEG results, from 0 to 100, or -1 for the default.
+  int quality = -1;
+};
+
+struct ConvertedImage
+{
+  std::string mimeType;
+  int width = 0;
+  int height = 0;
+  GBytes *bytes = nullptr;
+};
+
+// The image types GdkPixbuf can decode, PNG first since it is lossless and
+// what most applications copy.
+std::vector<std::string> get_readable_image_types();
+// Whether GdkPixbuf can encode mimeType.
+bool is_writable_image_type(const std::string &mimeType);
+
+// Decodes the image in source, which is of sourceType, then scales it down
+// and encodes it as options ask. An image that needs neither is returned as
+// it is, without being decoded completely. On success the caller owns
+// result.bytes. On failure, error is set and false is returned.
+//
+// Decoding a large image takes a while, so this is meant to run on a worker.
+// It does not use GTK.
+bool convert_image(
+    GBytes *source,
+    const std::string &sourceType,
+    const ImageOptions &options,
+    ConvertedImage &result,
+    GError **error);
+
+#endif  // RICH_CLIPBOARD_LINUX_CLIPBOARD_IMAGE_H_
@@ -0,0 +1,156 @@
+#include "clipboard_stats.h"
+
+using namespace std;
+
+// Upper bounds of the latency histogram buckets, in microseconds. A last
+// bucket counts everything slower.
+const gint64 kLatencyBucketsUs[] = {
+    100,
+    250,
+    500,
+    1000,
+    2500,
+    5000,
+    10000,
+    25000,
+    50000,
+    100000,
+    250000,
+    500000,
+    1000000,
+    2500000,
+    5000000,
+};
+
+ClipboardStats::ClipboardStats()
+{
+  reset();
+}
+
+void ClipboardStats::recordCall(const string &method, gint64 durationUs)
+{
+  auto &stats = methods[method];
+  if (stats.histogram.empty())
+  {
+    stats.histogram.resize(G_N_ELEMENTS(kLatencyBucketsUs) + 1);
+  }
+  stats.calls++;
+  stats.totalUs += durationUs;
+  stats.maxUs = MAX(stats.maxUs, durationUs);
+
+  gsize bucket = 0;
+  while (bucket < G_N_ELEMENTS(kLatencyBucketsUs) && durationUs > kLatencyBucketsUs[bucket])
+  {
+    bucket++;
+  }
+  stats.histogram[bucket]++;
+}
+
+void ClipboardStats::recordRead(const string &mimeType, gsize length)
+{
+  types[mimeType].bytesRead += length;
+}
+
+void ClipboardStats::recordWrite(const string &mimeType, gsize length)
+{
+  types[mimeType].bytesWritten += length;
+}
+
+void ClipboardStats::recordPaste(const string &mimeType, gsize length)
+{
+  auto &stats = types[mimeType];
+  stats.pastesServed++;
+  stats.bytesServed += length;
+  pastesServed++;
+}
+
+void ClipboardStats::recordStore(StoreOutcome outcome)
+{
+  switch (outcome)
+  {
+  case kStoreOutcomeStored:
+    storesSucceeded++;
+    break;
+  case kStoreOutcomeFailed:
+    storesFailed++;
+    break;
+  case kStoreOutcomeTimedOut:
+    storesTimedOut++;
+    break;
+  }
+}
+
+void ClipboardStats::recordDeduplicatedWrite()
+{
+  writesDeduplicated++;
+}
+
+void ClipboardStats::recordOwnedBytes(gsize length)
+{
+  peakOwnedBytes = MAX(peakOwnedBytes, length);
+}
+
+void ClipboardStats::reset()
+{
+  since = g_get_real_time() / 1000;
+  methods.clear();
+  types.clear();
+  pastesServed = 0;
+  storesSucceeded = 0;
+  storesFailed = 0;
+  storesTimedOut = 0;
+  writesDeduplicated = 0;
+  peakOwnedBytes = 0;
+}
+
+FlValue *ClipboardStats::toValue()
+{
+  auto *value = fl_value_new_map();
+  fl_value_set_string_take(value, "since", fl_value_new_int(since));
+
+  auto *buckets = fl_value_new_list();
+  for (auto bound : kLatencyBucketsUs)
+  {
+    fl_value_append_take(buckets, fl_value_new_int(bound));
+  }
+  fl_value_set_string_take(value, "latencyBucketsUs", buckets);
+
+  auto *methodsValue = fl_value_new_map();
+  for (auto &entry : methods)
+  {
+    auto &stats = entry.second;
+    auto *methodValue = fl_value_new_map();
+    fl_value_set_string_take(methodValue, "calls", fl_value_new_int(stats.calls));
+    fl_value_set_string_take(methodValue, "totalUs", fl_value_new_int(stats.totalUs));
+    fl_value_set_string_take(methodValue, "maxUs", fl_value_new_int(stats.maxUs));
+    auto *histogram = fl_value_new_list();
+    for (auto count : stats.histogram)
+    {
+      fl_value_append_take(histogram, fl_value_new_int(count));
+    }
+    fl_value_set_string_take(methodValue, "histogram", histogram);
+    fl_value_set_string_take(methodsValue, entry.first.c_str(), methodValue);
+  }
+  fl_value_set_string_take(value, "methods", methodsValue);
+
+  auto *typesValue = fl_value_new_map();
+  for (auto &entry : types)
+  {
+    auto &stats = entry.second;
+    auto *typeValue = fl_value_new_map();
+    fl_value_set_string_take(typeValue, "bytesRead", fl_value_new_int(stats.bytesRead));
+    fl_value_set_string_take(typeValue, "bytesWritten", fl_value_new_int(stats.bytesWritten));
+    fl_value_set_string_take(typeValue, "pastesServed", fl_value_new_int(stats.pastesServed));
+    fl_value_set_string_take(typeValue, "bytesServed", fl_value_new_int(stats.bytesServed));
+    fl_value_set_string_take(typesValue, entry.first.c_str(), typeValue);
+  }
+  fl_value_set_string_take(value, "types", typesValue);
+
+  fl_value_set_string_take(value, "pastesServed", fl_value_new_int(pastesServed));
+  fl_value_set_string_take(value, "storesSucceeded", fl_value_new_int(storesSucceeded));
+  fl_value_set_string_take(value, "storesFailed", fl_value_new_int(storesFailed));
+  fl_value_set_string_take(value, "storesTimedOut", fl_value_new_int(storesTimedOut));
+  fl_value_set_string_take(value, "writesDeduplicated", fl_value_new_int(writesDeduplicated));
+  fl_value_set_string_take(value, "peakOwnedBytes", fl_value_new_int(peakOwnedBytes));
+  return value;
+}
@@ -0,0 +1,64 @@
+#ifndef RICH_CLIPBOARD_LINUX_CLIPBOARD_STATS_H_
+#define RICH_CLIPBOARD_LINUX_CLIPBOARD_STATS_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "clipboard_backend.h"
+
+// Counters and latency histograms of the plugin's work since it started or
+// was last reset, which getStats reports so applications can ship them to
+// their telemetry.
+class ClipboardStats
+{
+private:
+  struct MethodStats
+  {
+    guint64 calls = 0;
+    gint64 totalUs = 0;
+    gint64 maxUs = 0;
+    std::vector<guint64> histogram;
+  };
+  struct TypeStats
+  {
+    guint64 bytesRead = 0;
+    guint64 bytesWritten = 0;
+    guint64 pastesServed = 0;
+    guint64 bytesServed = 0;
+  };
+
+  gint64 since;
+  std::map<std::string, MethodStats> methods;
+  std::map<std::string, TypeStats> types;
+  guint64 pastesServed;
+  guint64 storesSucceeded;
+  guint64 storesFailed;
+  guint64 storesTimedOut;
+  guint64 writesDeduplicated;
+  gsize peakOwnedBytes;
+
+public:
+  ClipboardStats();
+
+  // A method call that took durationUs from its arrival to its answer.
+  void recordCall(const std::string &method, gint64 durationUs);
+  // Bytes read from another application.
+  void recordRead(const std::string &mimeType, gsize length);
+  // Bytes Dart put on the clipboard.
+  void recordWrite(const std::string &mimeType, gsize length);
+  // A paste of our data by another application.
+  void recordPaste(const std::string &mimeType, gsize length);
+  void recordStore(StoreOutcome outcome);
+  // A setData that was dropped because we own the same data already.
+  void recordDeduplicatedWrite();
+  // The size of all the data we currently own.
+  void recordOwnedBytes(gsize length);
+
+  void reset();
+  FlValue *toValue();
+};
+
+#endif  // RICH_CLIPBOARD_LINUX_CLIPBOARD_STATS_H_
@@ -0,0 +1,34 @@
+#include "clipboard_worker.h"
+
+using namespace std;
+
+struct WorkerJob
+{
+  function<void()> work;
+  function<void()> done;
+};
+
+static void worker_job_free(gpointer data)
+{
+  delete static_cast<WorkerJob *>(data);
+}
+
+static void worker_thread_cb(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+  static_cast<WorkerJob *>(task_data)->work();
+  g_task_return_boolean(task, TRUE);
+}
+
+static void worker_done_cb(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+  static_cast<WorkerJob *>(g_task_get_task_data(G_TASK(result)))->done();
+}
+
+void run_on_worker(function<void()> work, function<void()> done)
+{
+  // The task reports back on the main context of this thread, which is the
+  // GTK main loop.
+  g_autoptr(GTask) task = g_task_new(nullptr, nullptr, worker_done_cb, nullptr);
+  g_task_set_task_data(task, new WorkerJob{move(work), move(done)}, worker_job_free);
+  g_task_run_in_thread(task, worker_thread_cb);
+}
@@ -0,0 +1,19 @@
+#ifndef RICH_CLIPBOARD_LINUX_CLIPBOARD_WORKER_H_
+#define RICH_CLIPBOARD_LINUX_CLIPBOARD_WORKER_H_
+
+#include <gio/gio.h>
+
+#include <functional>
+
+// Payloads smaller than this are processed right away on the main thread,
+// where the hop to a worker and back would cost more than it saves.
+const gsize kWorkerMinLength = 64 * 1024;
+
+// Runs work on GLib's pool of worker threads, then done on the main loop.
+//
+// work must not touch GTK, nor anything the main thread may use or free
+// before done runs. Whatever it needs is handed over in its captures, and
+// its results are handed back the same way.
+void run_on_worker(std::function<void()> work, std::function<void()> done);
+
+#endif  // RICH_CLIPBOARD_LINUX_CLIPBOARD_WORKER_H_
@@ -0,0 +1,101 @@
+#include "content_hash.h"
+
+#include <cstring>
+
+const guint64 kPrime1 = G_GUINT64_CONSTANT(0x9e3779b185ebca87);
+const guint64 kPrime2 = G_GUINT64_CONSTANT(0xc2b2ae3d27d4eb4f);
+const guint64 kPrime3 = G_GUINT64_CONSTANT(0x165667b19e3779f9);
+const guint64 kPrime4 = G_GUINT64_CONSTANT(0x85ebca77c2b2ae63);
+const guint64 kPrime5 = G_GUINT64_CONSTANT(0x27d4eb2f165667c5);
+
+static inline guint64 rotate_left(guint64 value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static inline guint64 read64(const guchar *p)
+{
+  guint64 value;
+  memcpy(&value, p, sizeof(value));
+  return GUINT64_FROM_LE(value);
+}
+
+static inline guint32 read32(const guchar *p)
+{
+  guint32 value;
+  memcpy(&value, p, sizeof(value));
+  return GUINT32_FROM_LE(value);
+}
+
+static inline guint64 accumulate(guint64 accumulator, guint64 input)
+{
+  accumulator += input * kPrime2;
+  accumulator = rotate_left(accumulator, 31);
+  return accumulator * kPrime1;
+}
+
+static inline guint64 merge_round(guint64 accumulator, guint64 value)
+{
+  accumulator ^= accumulate(0, value);
+  return accumulator * kPrime1 + kPrime4;
+}
+
+guint64 content_hash(const void *data, gsize length, guint64 seed)
+{
+  auto *p = static_cast<const guchar *>(data);
+  auto *end = p + length;
+  guint64 hash;
+
+  if (length >= 32)
+  {
+    // Four independent lanes keep the multipliers busy.
+    guint64 v1 = seed + kPrime1 + kPrime2;
+    guint64 v2 = seed + kPrime2;
+    guint64 v3 = seed;
+    guint64 v4 = seed - kPrime1;
+    auto *limit = end - 32;
+    do
+    {
+      v1 = accumulate(v1, read64(p));
+      v2 = accumulate(v2, read64(p + 8));
+      v3 = accumulate(v3, read64(p + 16));
+      v4 = accumulate(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+    hash = merge_round(hash, v1);
+    hash = merge_round(hash, v2);
+    hash = merge_round(hash, v3);
+    hash = merge_round(hash, v4);
+  }
+  else
+  {
+    hash = seed + kPrime5;
+  }
+  hash += length;
+
+  for (; p + 8 <= end; p += 8)
+  {
+    hash ^= accumulate(0, read64(p));
+    hash = rotate_left(hash, 27) * kPrime1 + kPrime4;
+  }
+  if (p + 4 <= end)
+  {
+    hash ^= read32(p) * kPrime1;
+    hash = rotate_left(hash, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; p++)
+  {
+    hash ^= *p * kPrime5;
+    hash = rotate_left(hash, 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
@@ -0,0 +1,11 @@
+#ifndef RICH_CLIPBOARD_LINUX_CONTENT_HASH_H_
+#define RICH_CLIPBOARD_LINUX_CONTENT_HASH_H_
+
+#include <glib.h>
+
+// Hashes data with XXH64, a fast non-cryptographic hash. It is used to tell
+// clipboard payloads apart without comparing or transferring them, so it
+// must not be relied on against deliberate collisions.
+guint64 content_hash(const void *data, gsize length, guint64 seed = 0);
+
+#endif  // RICH_CLIPBOARD_LINUX_CONTENT_HASH_H_
@@ -0,0 +1,243 @@
+#include "gtk_clipboard_backend.h"
+
+#include <cstring>
+#include <memory>
+
+using namespace std;
+
+const GdkAtom kGdkAtomUtf8String = gdk_atom_intern_static_string("UTF8_STRING");
+const GdkAtom kGdkAtomTextPlainUtf8 = gdk_atom_intern_static_string("text/plain;charset=utf-8");
+const GdkAtom kGdkAtomClipboardManager = gdk_atom_intern_static_string("CLIPBOARD_MANAGER");
+
+// How long to wait for the clipboard manager to take our data, the same
+// limit gtk_clipboard_store uses.
+const guint kStoreTimeoutMs = 10000;
+
+// A requestContents call waiting for GTK.
+struct ContentsRequest
+{
+  bool text;
+  ClipboardBackend::ContentsCallback callback;
+};
+
+static void gtk_clipboard_request_targets_callback(
+    GtkClipboard *clipboard,
+    GdkAtom *atoms,
+    gint n_atoms,
+    gpointer user_data)
+{
+  unique_ptr<ClipboardBackend::TargetsCallback> callback(static_cast<ClipboardBackend::TargetsCallback *>(user_data));
+  (*callback)(atoms, n_atoms);
+}
+
+static void gtk_clipboard_request_contents_callback(
+    GtkClipboard *clipboard,
+    GtkSelectionData *selectionData,
+    gpointer user_data)
+{
+  unique_ptr<ContentsRequest> request(static_cast<ContentsRequest *>(user_data));
+  if (selectionData == nullptr || gtk_selection_data_get_length(selectionData) < 0)
+  {
+    request->callback(nullptr, 0, nullptr);
+  }
+  else if (request->text)
+  {
+    // The converted text is ours, so it is handed over as it is.
+    auto *text = gtk_selection_data_get_text(selectionData);
+    gsize length = text != nullptr ? strlen(reinterpret_cast<gchar *>(text)) : 0;
+    g_autoptr(GBytes) bytes = text != nullptr ? g_bytes_new_take(text, length) : nullptr;
+    request->callback(text, length, bytes);
+  }
+  else
+  {
+    // GTK frees the data after this, so readers that keep it copy it.
+    gint length;
+    auto *data = gtk_selection_data_get_data_with_length(selectionData, &length);
+    request->callback(data, length, nullptr);
+  }
+}
+
+static void gtk_clipboard_get_callback(
+    GtkClipboard *clipboard,
+    GtkSelectionData *selectionData,
+    guint info,
+    gpointer user_data_or_owner)
+{
+  auto *source = static_cast<ClipboardSource *>(user_data_or_owner);
+  source->get(
+      info,
+      [selectionData](const guchar *data, gsize length, bool text, GBytes *bytes)
+      {
+        auto target = gtk_selection_data_get_target(selectionData);
+        if (!text || target == kGdkAtomUtf8String || target == kGdkAtomTextPlainUtf8)
+        {
+          // Our text is already UTF-8, so these targets need no conversion.
+          gtk_selection_data_set(selectionData, target, 8, data, length);
+        }
+        else
+        {
+          gtk_selection_data_set_text(selectionData, reinterpret_cast<const gchar *>(data), length);
+        }
+      });
+}
+
+static void gtk_clipboard_clear_callback(GtkClipboard *clipboard, gpointer user_data_or_owner)
+{
+  static_cast<ClipboardSource *>(user_data_or_owner)->clear();
+}
+
+GtkClipboardBackend::GtkClipboardBackend(GdkDisplay *display)
+    : display(display),
+      clipboard(gtk_clipboard_get_for_display(display, GDK_SELECTION_CLIPBOARD)),
+      primary(gtk_clipboard_get_for_display(display, GDK_SELECTION_PRIMARY))
+{
+}
+
+GtkClipboardBackend::~GtkClipboardBackend()
+{
+  g_clear_signal_handler(&ownerChangeHandler, clipboard);
+  g_clear_handle_id(&storeTimeout, g_source_remove);
+  g_clear_pointer(&storeWidget, gtk_widget_destroy);
+}
+
+GtkClipboard *GtkClipboardBackend::getClipboard(GdkAtom selection)
+{
+  return selection == GDK_SELECTION_PRIMARY ? primary : clipboard;
+}
+
+void GtkClipboardBackend::ownerChangeCb(GtkClipboard *clipboard, GdkEvent *event, gpointer user_data)
+{
+  auto *backend = static_cast<GtkClipboardBackend *>(user_data);
+  backend->ownerChangeCallback(event->owner_change.selection_time);
+}
+
+bool GtkClipboardBackend::reportsOwnerChanges()
+{
+  return gdk_display_supports_selection_notification(display);
+}
+
+void GtkClipboardBackend::setOwnerChangeCallback(OwnerChangeCallback callback)
+{
+  ownerChangeCallback = move(callback);
+  if (ownerChangeHandler == 0)
+  {
+    ownerChangeHandler = g_signal_connect(clipboard, "owner-change", G_CALLBACK(ownerChangeCb), this);
+  }
+}
+
+void GtkClipboardBackend::requestTargets(GdkAtom selection, TargetsCallback callback)
+{
+  gtk_clipboard_request_targets(
+      getClipboard(selection),
+      gtk_clipboard_request_targets_callback,
+      new TargetsCallback(move(callback)));
+}
+
+void GtkClipboardBackend::requestContents(GdkAtom selection, GdkAtom target, bool text, ContentsCallback callback)
+{
+  gtk_clipboard_request_contents(
+      getClipboard(selection),
+      target,
+      gtk_clipboard_request_contents_callback,
+      new ContentsRequest{text, move(callback)});
+}
+
+void GtkClipboardBackend::setData(
+    GdkAtom selection,
+    const GtkTargetEntry *targets,
+    gint numTargets,
+    ClipboardSource *source)
+{
+  gtk_clipboard_set_with_data(
+      getClipboard(selection),
+      targets,
+      numTargets,
+      gtk_clipboard_get_callback,
+      gtk_clipboard_clear_callback,
+      source);
+}
+
+void GtkClipboardBackend::clear(GdkAtom selection)
+{
+  gtk_clipboard_clear(getClipboard(selection));
+}
+
+void GtkClipboardBackend::empty(GdkAtom selection)
+{
+  // gtk_clipboard_clear only empties the clipboard if we own it, so take
+  // ownership of it first.
+  auto *selectionClipboard = getClipboard(selection);
+  gtk_clipboard_set_text(selectionClipboard, "", 0);
+  gtk_clipboard_clear(selectionClipboard);
+}
+
+void GtkClipboardBackend::setCanStore(const GtkTargetEntry *targets, gint numTargets)
+{
+  gtk_clipboard_set_can_store(clipboard, targets, numTargets);
+}
+
+void GtkClipboardBackend::finishStore(StoreOutcome outcome)
+{
+  g_clear_handle_id(&storeTimeout, g_source_remove);
+  if (!storeCallback)
+  {
+    return;
+  }
+  auto callback = move(storeCallback);
+  storeCallback = nullptr;
+  callback(outcome);
+}
+
+gboolean GtkClipboardBackend::storeTimeoutCb(gpointer user_data)
+{
+  auto *backend = static_cast<GtkClipboardBackend *>(user_data);
+  backend->storeTimeout = 0;
+  backend->finishStore(kStoreOutcomeTimedOut);
+  return G_SOURCE_REMOVE;
+}
+
+gboolean GtkClipboardBackend::storeSelectionNotifyCb(
+    GtkWidget *widget,
+    GdkEventSelection *event,
+    gpointer user_data)
+{
+  auto *backend = static_cast<GtkClipboardBackend *>(user_data);
+  if (event->selection != kGdkAtomClipboardManager || !backend->storeCallback)
+  {
+    return FALSE;
+  }
+  // The manager answers with no property when it refused the data.
+  backend->finishStore(event->property != GDK_NONE ? kStoreOutcomeStored : kStoreOutcomeFailed);
+  return TRUE;
+}
+
+// Unlike gtk_clipboard_store this does not wait in a nested loop: the manager
+// pulls the targets through the normal main loop, and the outcome arrives as
+// a SelectionNotify on storeWidget.
+void GtkClipboardBackend::store(const vector<GdkAtom> &targets, StoreCallback callback)
+{
+  // A handoff of data we no longer own is moot.
+  finishStore(kStoreOutcomeFailed);
+
+  if (!gdk_display_supports_clipboard_persistence(display))
+  {
+    callback(kStoreOutcomeFailed);
+    return;
+  }
+
+  if (storeWidget == nullptr)
+  {
+    storeWidget = gtk_invisible_new_for_screen(gdk_display_get_default_screen(display));
+    gtk_widget_realize(storeWidget);
+    g_signal_connect(storeWidget, "selection-notify-event", G_CALLBACK(storeSelectionNotifyCb), this);
+  }
+
+  storeCallback = move(callback);
+  storeTimeout = g_timeout_add(kStoreTimeoutMs, storeTimeoutCb, this);
+  gdk_display_store_clipboard(
+      display,
+      gtk_widget_get_window(storeWidget),
+      GDK_CURRENT_TIME,
+      targets.data(),
+      targets.size());
+}
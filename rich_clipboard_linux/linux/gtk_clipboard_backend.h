@@ -0,0 +1,51 @@
+#ifndef RICH_CLIPBOARD_LINUX_GTK_CLIPBOARD_BACKEND_H_
+#define RICH_CLIPBOARD_LINUX_GTK_CLIPBOARD_BACKEND_H_
+
+#include "clipboard_backend.h"
+
+// The system clipboard, through GtkClipboard.
+class GtkClipboardBackend : public ClipboardBackend
+{
+private:
+  GdkDisplay *display;
+  GtkClipboard *clipboard;
+  GtkClipboard *primary;
+
+  OwnerChangeCallback ownerChangeCallback;
+  gulong ownerChangeHandler = 0;
+
+  // The window the clipboard manager reports the outcome of a store to, and
+  // the store that is waiting for it.
+  GtkWidget *storeWidget = nullptr;
+  guint storeTimeout = 0;
+  StoreCallback storeCallback;
+
+  GtkClipboard *getClipboard(GdkAtom selection);
+  void finishStore(StoreOutcome outcome);
+
+  static void ownerChangeCb(GtkClipboard *clipboard, GdkEvent *event, gpointer user_data);
+  static gboolean storeTimeoutCb(gpointer user_data);
+  static gboolean storeSelectionNotifyCb(GtkWidget *widget, GdkEventSelection *event, gpointer user_data);
+
+public:
+  explicit GtkClipboardBackend(GdkDisplay *display);
+  ~GtkClipboardBackend() override;
+  GtkClipboardBackend(const GtkClipboardBackend &) = delete;
+  GtkClipboardBackend &operator=(const GtkClipboardBackend &) = delete;
+
+  bool reportsOwnerChanges() override;
+  void setOwnerChangeCallback(OwnerChangeCallback callback) override;
+  void requestTargets(GdkAtom selection, TargetsCallback callback) override;
+  void requestContents(GdkAtom selection, GdkAtom target, bool text, ContentsCallback callback) override;
+  void setData(
+      GdkAtom selection,
+      const GtkTargetEntry *targets,
+      gint numTargets,
+      ClipboardSource *source) override;
+  void clear(GdkAtom selection) override;
+  void empty(GdkAtom selection) override;
+  void setCanStore(const GtkTargetEntry *targets, gint numTargets) override;
+  void store(const std::vector<GdkAtom> &targets, StoreCallback callback) override;
+};
+
+#endif  // RICH_CLIPBOARD_LINUX_GTK_CLIPBOARD_BACKEND_H_
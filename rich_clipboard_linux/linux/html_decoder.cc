@@ -0,0 +1,354 @@
+#include "html_decoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// How far into the document a <meta> tag declaring the charset is looked
+// for, the same limit browsers use.
+const gsize kMetaPrescanLength = 1024;
+
+enum HtmlEncoding
+{
+  kHtmlEncodingUtf8,
+  kHtmlEncodingUtf16Le,
+  kHtmlEncodingUtf16Be,
+  // Anything else, converted with g_convert.
+  kHtmlEncodingOther,
+};
+
+static HtmlEncoding encoding_for_charset(const string &charset)
+{
+  if (charset == "utf-8" || charset == "utf8")
+  {
+    return kHtmlEncodingUtf8;
+  }
+  if (charset == "utf-16be")
+  {
+    return kHtmlEncodingUtf16Be;
+  }
+  // Without a byte order mark, UTF-16 on the clipboard is little endian in
+  // practice.
+  if (charset == "utf-16" || charset == "utf-16le" || charset == "ucs-2" || charset == "unicode")
+  {
+    return kHtmlEncodingUtf16Le;
+  }
+  return kHtmlEncodingOther;
+}
+
+// Lowercases a charset name and strips the quotes and spaces around it.
+static string normalize_charset(const gchar *begin, const gchar *end)
+{
+  while (begin < end && (g_ascii_isspace(*begin) || *begin == '"' || *begin == '\''))
+  {
+    begin++;
+  }
+  auto *nameEnd = begin;
+  while (nameEnd < end && !g_ascii_isspace(*nameEnd) && strchr("\"';>/", *nameEnd) == nullptr)
+  {
+    nameEnd++;
+  }
+  string charset(begin, nameEnd);
+  transform(charset.begin(), charset.end(), charset.begin(), g_ascii_tolower);
+  return charset;
+}
+
+// Finds the charset parameter in a MIME type like "text/html; charset=utf-8",
+// or in the content attribute of an http-equiv <meta> tag.
+static string find_charset_parameter(const gchar *begin, const gchar *end)
+{
+  static const char kCharset[] = "charset";
+  auto *found = search(
+      begin, end, kCharset, kCharset + strlen(kCharset),
+      [](gchar a, gchar b)
+      {
+        return g_ascii_tolower(a) == b;
+      });
+  if (found == end)
+  {
+    return string();
+  }
+  auto *value = found + strlen(kCharset);
+  while (value < end && g_ascii_isspace(*value))
+  {
+    value++;
+  }
+  if (value == end || *value != '=')
+  {
+    return string();
+  }
+  return normalize_charset(value + 1, end);
+}
+
+// Looks for <meta charset="..."> or <meta http-equiv="Content-Type"
+// content="text/html; charset=..."> near the start of the document.
+static string find_meta_charset(const guchar *data, gsize length)
+{
+  auto *begin = reinterpret_cast<const gchar *>(data);
+  auto *end = begin + MIN(length, kMetaPrescanLength);
+  static const char kMeta[] = "<meta";
+  auto *tag = begin;
+  while (true)
+  {
+    tag = search(
+        tag, end, kMeta, kMeta + strlen(kMeta),
+        [](gchar a, gchar b)
+        {
+          return g_ascii_tolower(a) == b;
+        });
+    if (tag == end)
+    {
+      return string();
+    }
+    auto *tagEnd = find(tag, end, '>');
+    auto charset = find_charset_parameter(tag, tagEnd);
+    if (!charset.empty())
+    {
+      return charset;
+    }
+    tag = tagEnd;
+  }
+}
+
+// Guesses UTF-16 without a byte order mark from ASCII characters, which have a
+// zero byte on the same side of every code unit. Other characters may have a
+// zero byte on the other side, but markup has few of them.
+static HtmlEncoding guess_encoding(const guchar *data, gsize length)
+{
+  gsize units = MIN(length, 64) / 2;
+  gsize zeroLow = 0;
+  gsize zeroHigh = 0;
+  for (gsize i = 0; i < units; i++)
+  {
+    zeroLow += data[2 * i] == 0;
+    zeroHigh += data[2 * i + 1] == 0;
+  }
+  if (zeroHigh > units / 2 && zeroLow < zeroHigh / 4)
+  {
+    return kHtmlEncodingUtf16Le;
+  }
+  if (zeroLow > units / 2 && zeroHigh < zeroLow / 4)
+  {
+    return kHtmlEncodingUtf16Be;
+  }
+  return kHtmlEncodingUtf8;
+}
+
+static void append_utf8(guint32 c, string &out)
+{
+  gchar buffer[6];
+  out.append(buffer, g_unichar_to_utf8(c, buffer));
+}
+
+// Appends text to out with CRLF and lone CR line endings turned into LF.
+static void append_normalizing_newlines(const gchar *text, gsize length, string &out)
+{
+  auto *end = text + length;
+  while (text < end)
+  {
+    auto *cr = static_cast<const gchar *>(memchr(text, '\r', end - text));
+    if (cr == nullptr)
+    {
+      out.append(text, end - text);
+      return;
+    }
+    out.append(text, cr - text);
+    out += '\n';
+    text = cr + 1;
+    if (text < end && *text == '\n')
+    {
+      text++;
+    }
+  }
+}
+
+static inline guint32 read_unit(const guchar *unit, bool bigEndian)
+{
+  return bigEndian ? (unit[0] << 8) | unit[1] : unit[0] | (unit[1] << 8);
+}
+
+// Transcodes UTF-16 to UTF-8 and normalizes line endings in the same pass.
+//
+// Markup is mostly ASCII, so four code units are checked at a time in one
+// 64-bit word. Blocks of ASCII without CR are copied straight out, and only
+// the rest goes through the code unit loop. Unpaired surrogates become
+// U+FFFD.
+static void append_utf16(const guchar *data, gsize length, bool bigEndian, string &out)
+{
+  const guint64 kLaneOnes = G_GUINT64_CONSTANT(0x0001000100010001);
+  const guint64 kLaneHighBits = G_GUINT64_CONSTANT(0x8000800080008000);
+  const guint64 kNonAscii = G_GUINT64_CONSTANT(0xff80ff80ff80ff80);
+  const guint64 kCarriageReturns = G_GUINT64_CONSTANT(0x000d000d000d000d);
+  const bool swap = bigEndian != (G_BYTE_ORDER == G_BIG_ENDIAN);
+
+  gsize units = length / 2;
+  out.reserve(out.size() + units);
+  gsize i = 0;
+  while (i < units)
+  {
+    if (i + 4 <= units)
+    {
+      guint64 word;
+      memcpy(&word, data + 2 * i, sizeof(word));
+      if (swap)
+      {
+        word = ((word & G_GUINT64_CONSTANT(0x00ff00ff00ff00ff)) << 8) |
+               ((word >> 8) & G_GUINT64_CONSTANT(0x00ff00ff00ff00ff));
+      }
+      auto crs = word ^ kCarriageReturns;
+      if ((word & kNonAscii) == 0 && ((crs - kLaneOnes) & ~crs & kLaneHighBits) == 0)
+      {
+        gchar ascii[4];
+        for (int lane = 0; lane < 4; lane++)
+        {
+          int shift = 16 * (G_BYTE_ORDER == G_LITTLE_ENDIAN ? lane : 3 - lane);
+          ascii[lane] = static_cast<gchar>(word >> shift);
+        }
+        out.append(ascii, sizeof(ascii));
+        i += 4;
+        continue;
+      }
+    }
+
+    guint32 c = read_unit(data + 2 * i++, bigEndian);
+    if (c == '\r')
+    {
+      out += '\n';
+      if (i < units && read_unit(data + 2 * i, bigEndian) == '\n')
+      {
+        i++;
+      }
+      continue;
+    }
+    if (c >= 0xd800 && c <= 0xdbff && i < units)
+    {
+      guint32 low = read_unit(data + 2 * i, bigEndian);
+      if (low >= 0xdc00 && low <= 0xdfff)
+      {
+        c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+        i++;
+      }
+      else
+      {
+        c = 0xfffd;
+      }
+    }
+    else if (c >= 0xd800 && c <= 0xdfff)
+    {
+      c = 0xfffd;
+    }
+    append_utf8(c, out);
+  }
+}
+
+bool decode_html(const guchar *data, gsize length, const gchar *target, string &decoded)
+{
+  auto encoding = kHtmlEncodingUtf8;
+  string charsetName;
+  bool hasBom = true;
+  if (length >= 3 && data[0] == 0xef && data[1] == 0xbb && data[2] == 0xbf)
+  {
+    data += 3;
+    length -= 3;
+  }
+  else if (length >= 2 && data[0] == 0xff && data[1] == 0xfe)
+  {
+    encoding = kHtmlEncodingUtf16Le;
+    data += 2;
+    length -= 2;
+  }
+  else if (length >= 2 && data[0] == 0xfe && data[1] == 0xff)
+  {
+    encoding = kHtmlEncodingUtf16Be;
+    data += 2;
+    length -= 2;
+  }
+  else
+  {
+    hasBom = false;
+    if (target != nullptr)
+    {
+      charsetName = find_charset_parameter(target, target + strlen(target));
+    }
+    if (!charsetName.empty())
+    {
+      encoding = encoding_for_charset(charsetName);
+    }
+    else
+    {
+      encoding = guess_encoding(data, length);
+      if (encoding == kHtmlEncodingUtf8)
+      {
+        charsetName = find_meta_charset(data, length);
+        // A <meta> tag that can be read as ASCII rules out UTF-16.
+        auto metaEncoding = encoding_for_charset(charsetName);
+        if (!charsetName.empty() && metaEncoding == kHtmlEncodingOther)
+        {
+          encoding = kHtmlEncodingOther;
+        }
+      }
+    }
+  }
+
+  auto *text = reinterpret_cast<const gchar *>(data);
+  switch (encoding)
+  {
+  case kHtmlEncodingUtf16Le:
+  case kHtmlEncodingUtf16Be:
+    decoded.clear();
+    append_utf16(data, length, encoding == kHtmlEncodingUtf16Be, decoded);
+    return true;
+
+  case kHtmlEncodingOther:
+  {
+    gsize written;
+    g_autofree gchar *converted = g_convert(text, length, "UTF-8", charsetName.c_str(), nullptr, &written, nullptr);
+    if (converted != nullptr)
+    {
+      decoded.clear();
+      append_normalizing_newlines(converted, written, decoded);
+      return true;
+    }
+    // An unknown charset, so fall back to reading it as UTF-8.
+    break;
+  }
+
+  case kHtmlEncodingUtf8:
+    break;
+  }
+
+  bool valid = g_utf8_validate(text, length, nullptr);
+  bool hasCr = memchr(text, '\r', length) != nullptr;
+  if (valid && !hasCr && !hasBom)
+  {
+    return false;
+  }
+
+  decoded.clear();
+  if (valid)
+  {
+    append_normalizing_newlines(text, length, decoded);
+  }
+  else
+  {
+    g_autofree gchar *repaired = g_utf8_make_valid(text, length);
+    append_normalizing_newlines(repaired, strlen(repaired), decoded);
+  }
+  return true;
+}
+
+bool is_html_target_with_parameters(const gchar *target)
+{
+  static const char kTextHtml[] = "text/html";
+  auto length = strlen(kTextHtml);
+  if (g_ascii_strncasecmp(target, kTextHtml, length) != 0)
+  {
+    return false;
+  }
+  while (target[length] == ' ')
+  {
+    length++;
+  }
+  return target[length] == ';';
+}
@@ -0,0 +1,25 @@
+#ifndef RICH_CLIPBOARD_LINUX_HTML_DECODER_H_
+#define RICH_CLIPBOARD_LINUX_HTML_DECODER_H_
+
+#include <glib.h>
+
+#include <string>
+
+// Decodes HTML another application put on the clipboard into UTF-8 with LF
+// line endings, which is what getData hands to Dart.
+//
+// The encoding is taken from a byte order mark, else from the charset
+// parameter of target, the name of the target the HTML was read from, else
+// from a <meta> tag near the start of the document. Without any of them the
+// HTML is taken to be UTF-8, or UTF-16 if it looks like it.
+//
+// Returns false if data is valid UTF-8 with LF line endings already, so the
+// caller can use it as is. Otherwise the result is stored in decoded.
+bool decode_html(const guchar *data, gsize length, const gchar *target, std::string &decoded);
+
+// Whether target is text/html with parameters, like the
+// text/html;charset=utf-16 some applications advertise instead of text/html.
+// decode_html reads the charset from it.
+bool is_html_target_with_parameters(const gchar *target);
+
+#endif  // RICH_CLIPBOARD_LINUX_HTML_DECODER_H_
@@ -0,0 +1,353 @@
+#include "html_text.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Elements whose contents are never shown.
+const char *const kHiddenElements[] = {"head", "script", "style", "template"};
+
+// Elements that start and end on a line of their own.
+const char *const kBlockElements[] = {
+    "address", "article", "aside", "blockquote", "caption", "dd", "details",
+    "div", "dl", "dt", "fieldset", "figcaption", "figure", "footer", "form",
+    "h1", "h2", "h3", "h4", "h5", "h6", "header", "hr", "li", "main", "nav",
+    "ol", "p", "pre", "section", "summary", "table", "tr", "ul"};
+
+struct NamedCharacter
+{
+  const char *name;
+  guint32 c;
+};
+
+// The character references that turn up in copied markup. Others are left
+// as they are.
+const NamedCharacter kNamedCharacters[] = {
+    {"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''},
+    {"nbsp", ' '}, {"copy", 0xa9}, {"reg", 0xae}, {"trade", 0x2122},
+    {"hellip", 0x2026}, {"ndash", 0x2013}, {"mdash", 0x2014},
+    {"lsquo", 0x2018}, {"rsquo", 0x2019}, {"ldquo", 0x201c}, {"rdquo", 0x201d},
+    {"laquo", 0xab}, {"raquo", 0xbb}, {"bull", 0x2022}, {"middot", 0xb7},
+    {"deg", 0xb0}, {"plusmn", 0xb1}, {"times", 0xd7}, {"divide", 0xf7},
+    {"sect", 0xa7}, {"para", 0xb6}, {"cent", 0xa2}, {"pound", 0xa3},
+    {"yen", 0xa5}, {"euro", 0x20ac}};
+
+template <size_t N>
+static bool contains(const char *const (&names)[N], const string &name)
+{
+  return find_if(
+             names, names + N,
+             [&name](const char *candidate)
+             {
+               return name == candidate;
+             }) != names + N;
+}
+
+// Builds the text, collapsing whitespace the way a browser lays it out.
+class TextBuilder
+{
+private:
+  string text;
+  // Whitespace was seen since the last character, and becomes one space if
+  // more text follows on the same line.
+  bool pendingSpace = false;
+  // Line breaks that are owed before the next text.
+  int pendingBreaks = 0;
+
+  void flush()
+  {
+    if (text.empty())
+    {
+      // Nothing goes before the first text.
+      pendingBreaks = 0;
+      pendingSpace = false;
+      return;
+    }
+    if (pendingBreaks > 0)
+    {
+      text.append(pendingBreaks, '\n');
+    }
+    else if (pendingSpace && text.back() != '\n' && text.back() != '\t')
+    {
+      text += ' ';
+    }
+    pendingBreaks = 0;
+    pendingSpace = false;
+  }
+
+public:
+  void appendSpace()
+  {
+    pendingSpace = true;
+  }
+  void append(const gchar *chars, gsize length)
+  {
+    flush();
+    text.append(chars, length);
+  }
+  void append(gchar c)
+  {
+    append(&c, 1);
+  }
+  void appendCharacter(guint32 c)
+  {
+    gchar buffer[6];
+    append(buffer, g_unichar_to_utf8(c, buffer));
+  }
+  // Text inside <pre> keeps its whitespace.
+  void appendPreformatted(gchar c)
+  {
+    if (c == '\n')
+    {
+      pendingBreaks++;
+      pendingSpace = false;
+      return;
+    }
+    flush();
+    text += c;
+  }
+  // Ends the line unless it is empty already. Consecutive block boundaries
+  // share a single line break.
+  void endBlock()
+  {
+    pendingBreaks = MAX(pendingBreaks, 1);
+    pendingSpace = false;
+  }
+  void lineBreak()
+  {
+    pendingBreaks++;
+    pendingSpace = false;
+  }
+  void cellBreak()
+  {
+    if (!text.empty() && pendingBreaks == 0 && text.back() != '\n')
+    {
+      text += '\t';
+    }
+    pendingSpace = false;
+  }
+  string finish()
+  {
+    return move(text);
+  }
+};
+
+// Decodes the character reference starting after the '&' at begin. Returns
+// where it ends, or begin if it is not one.
+static const gchar *decode_reference(const gchar *begin, const gchar *end, guint32 &c)
+{
+  auto *p = begin;
+  if (p < end && *p == '#')
+  {
+    p++;
+    bool hex = p < end && (*p == 'x' || *p == 'X');
+    if (hex)
+    {
+      p++;
+    }
+    auto *digits = p;
+    guint32 value = 0;
+    while (p < end && (hex ? g_ascii_isxdigit(*p) : g_ascii_isdigit(*p)) && value <= 0x10ffff)
+    {
+      value = value * (hex ? 16 : 10) + (hex ? g_ascii_xdigit_value(*p) : g_ascii_digit_value(*p));
+      p++;
+    }
+    if (p == digits)
+    {
+      return begin;
+    }
+    c = value == 0 || value > 0x10ffff || (value >= 0xd800 && value <= 0xdfff) ? 0xfffd : value;
+  }
+  else
+  {
+    while (p < end && g_ascii_isalnum(*p))
+    {
+      p++;
+    }
+    string name(begin, p);
+    auto *namedEnd = kNamedCharacters + G_N_ELEMENTS(kNamedCharacters);
+    auto *named = find_if(
+        kNamedCharacters, namedEnd,
+        [&name](const NamedCharacter &candidate)
+        {
+          return name == candidate.name;
+        });
+    if (named == namedEnd)
+    {
+      return begin;
+    }
+    c = named->c;
+  }
+  return p < end && *p == ';' ? p + 1 : p;
+}
+
+// Skips past the end of the tag whose name ends at p, stepping over quoted
+// attribute values that may contain '>'.
+static const gchar *skip_tag(const gchar *p, const gchar *end)
+{
+  gchar quote = 0;
+  for (; p < end; p++)
+  {
+    if (quote != 0)
+    {
+      if (*p == quote)
+      {
+        quote = 0;
+      }
+    }
+    else if (*p == '"' || *p == '\'')
+    {
+      quote = *p;
+    }
+    else if (*p == '>')
+    {
+      return p + 1;
+    }
+  }
+  return end;
+}
+
+// Finds the closing tag of a hidden element, and returns where it ends.
+static const gchar *skip_hidden(const gchar *p, const gchar *end, const string &name)
+{
+  string closing = "</" + name;
+  while (true)
+  {
+    p = search(
+        p, end, closing.begin(), closing.end(),
+        [](gchar a, gchar b)
+        {
+          return g_ascii_tolower(a) == b;
+        });
+    if (p == end)
+    {
+      return end;
+    }
+    auto *after = p + closing.size();
+    if (after == end || !g_ascii_isalnum(*after))
+    {
+      return skip_tag(after, end);
+    }
+    p = after;
+  }
+}
+
+string html_to_text(const gchar *html, gsize length)
+{
+  TextBuilder builder;
+  auto *p = html;
+  auto *end = html + length;
+  int preDepth = 0;
+
+  while (p < end)
+  {
+    auto c = *p;
+    if (c == '<')
+    {
+      if (end - p >= 4 && memcmp(p, "<!--", 4) == 0)
+      {
+        static const char kCommentEnd[] = "-->";
+        auto *commentEnd = search(p + 4, end, kCommentEnd, kCommentEnd + 3);
+        p = commentEnd == end ? end : commentEnd + 3;
+        continue;
+      }
+      auto *nameBegin = p + 1;
+      bool closing = nameBegin < end && *nameBegin == '/';
+      if (closing)
+      {
+        nameBegin++;
+      }
+      if (nameBegin < end && (*nameBegin == '!' || *nameBegin == '?'))
+      {
+        // A doctype or processing instruction.
+        p = skip_tag(nameBegin, end);
+        continue;
+      }
+      auto *nameEnd = nameBegin;
+      while (nameEnd < end && g_ascii_isalnum(*nameEnd))
+      {
+        nameEnd++;
+      }
+      if (nameEnd == nameBegin)
+      {
+        // Not a tag, like the '<' of "a < b".
+        builder.append(c);
+        p++;
+        continue;
+      }
+
+      string name(nameBegin, nameEnd);
+      transform(name.begin(), name.end(), name.begin(), g_ascii_tolower);
+      p = skip_tag(nameEnd, end);
+      bool selfClosing = p - html >= 2 && *(p - 2) == '/';
+
+      if (!closing && !selfClosing && contains(kHiddenElements, name))
+      {
+        p = skip_hidden(p, end, name);
+      }
+      else if (name == "br")
+      {
+        builder.lineBreak();
+      }
+      else if (name == "td" || name == "th")
+      {
+        if (!closing)
+        {
+          builder.cellBreak();
+        }
+      }
+      else if (contains(kBlockElements, name))
+      {
+        builder.endBlock();
+        if (name == "pre" && !selfClosing)
+        {
+          preDepth = closing ? MAX(preDepth - 1, 0) : preDepth + 1;
+        }
+      }
+      continue;
+    }
+
+    if (c == '&')
+    {
+      guint32 character;
+      auto *referenceEnd = decode_reference(p + 1, end, character);
+      if (referenceEnd != p + 1)
+      {
+        builder.appendCharacter(character);
+        p = referenceEnd;
+        continue;
+      }
+      builder.append(c);
+      p++;
+      continue;
+    }
+
+    if (preDepth > 0)
+    {
+      if (c != '\r')
+      {
+        builder.appendPreformatted(c);
+      }
+      p++;
+      continue;
+    }
+
+    if (g_ascii_isspace(c))
+    {
+      builder.appendSpace();
+      p++;
+      continue;
+    }
+
+    // Copy a run of ordinary characters at once.
+    auto *run = p;
+    while (p < end && *p != '<' && *p != '&' && !g_ascii_isspace(*p))
+    {
+      p++;
+    }
+    builder.append(run, p - run);
+  }
+
+  return builder.finish();
+}
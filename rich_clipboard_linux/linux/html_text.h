@@ -0,0 +1,16 @@
+#ifndef RICH_CLIPBOARD_LINUX_HTML_TEXT_H_
+#define RICH_CLIPBOARD_LINUX_HTML_TEXT_H_
+
+#include <glib.h>
+
+#include <string>
+
+// Flattens UTF-8 HTML into the plain text a browser would copy for it.
+//
+// Tags, comments and the contents of <head>, <script>, <style> and
+// <template> are dropped, character references are decoded, and whitespace
+// is collapsed outside <pre>. Block-level elements and <br> start a new
+// line, and table cells are separated by tabs.
+std::string html_to_text(const gchar *html, gsize length);
+
+#endif  // RICH_CLIPBOARD_LINUX_HTML_TEXT_H_
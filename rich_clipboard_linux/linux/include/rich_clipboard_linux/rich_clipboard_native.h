@@ -0,0 +1,39 @@
+#ifndef FLUTTER_PLUGIN_RICH_CLIPBOARD_NATIVE_H_
+#define FLUTTER_PLUGIN_RICH_CLIPBOARD_NATIVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rich_clipboard_plugin.h"
+
+// A C interface to the plugin that Dart calls over FFI rather than through
+// the method channel, so it works from any isolate.
+
+G_BEGIN_DECLS
+
+typedef enum {
+  RICH_CLIPBOARD_READ_OK = 0,
+  // The clipboard does not hold the type.
+  RICH_CLIPBOARD_READ_NOT_AVAILABLE = 1,
+  // No plugin is registered in this process, or it went away during the
+  // read.
+  RICH_CLIPBOARD_READ_NO_PLUGIN = 2,
+  // The transfer did not finish within 30 seconds.
+  RICH_CLIPBOARD_READ_TIMED_OUT = 3,
+} RichClipboardReadResult;
+
+// Reads mime_type from the clipboard the way getBinaryData does, and blocks
+// until the transfer has finished or timed out. It may be called from any
+// thread; the transfer itself runs on the GTK main loop.
+//
+// On RICH_CLIPBOARD_READ_OK, data points to the bytes, which the caller frees
+// with rich_clipboard_free_data.
+FLUTTER_PLUGIN_EXPORT int32_t rich_clipboard_read_data(const char* mime_type,
+                                                       uint8_t** data,
+                                                       size_t* length);
+
+FLUTTER_PLUGIN_EXPORT void rich_clipboard_free_data(void* data);
+
+G_END_DECLS
+
+#endif  // FLUTTER_PLUGIN_RICH_CLIPBOARD_NATIVE_H_
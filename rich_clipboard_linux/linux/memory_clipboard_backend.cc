@@ -0,0 +1,245 @@
+#include "memory_clipboard_backend.h"
+
+#include <memory>
+
+using namespace std;
+
+// A transfer scheduled by MemoryClipboardBackend::deliver.
+struct Delivery
+{
+  MemoryClipboardBackend *backend;
+  guint id;
+  function<void()> callback;
+};
+
+MemoryClipboardBackend::MemoryClipboardBackend(guint latencyUs, guint64 bytesPerSecond)
+    : latencyUs(latencyUs),
+      bytesPerSecond(bytesPerSecond)
+{
+}
+
+MemoryClipboardBackend::~MemoryClipboardBackend()
+{
+  auto ids = pending;
+  for (auto id : ids)
+  {
+    g_source_remove(id);
+  }
+  // Nothing outlives this clipboard, unlike data left on the system one.
+  for (auto &entry : selections)
+  {
+    auto *source = entry.second.source;
+    entry.second.source = nullptr;
+    if (source != nullptr)
+    {
+      source->clear();
+    }
+  }
+}
+
+gboolean MemoryClipboardBackend::deliverCb(gpointer user_data)
+{
+  auto *delivery = static_cast<Delivery *>(user_data);
+  delivery->backend->pending.erase(delivery->id);
+  delivery->callback();
+  return G_SOURCE_REMOVE;
+}
+
+void MemoryClipboardBackend::deliveryDestroyCb(gpointer user_data)
+{
+  delete static_cast<Delivery *>(user_data);
+}
+
+// Runs callback once a transfer of length bytes would have completed.
+void MemoryClipboardBackend::deliver(gsize length, function<void()> callback)
+{
+  guint64 delayUs = latencyUs;
+  if (bytesPerSecond != 0)
+  {
+    delayUs += length * G_USEC_PER_SEC / bytesPerSecond;
+  }
+
+  auto *delivery = new Delivery{this, 0, move(callback)};
+  if (delayUs == 0)
+  {
+    delivery->id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, deliverCb, delivery, deliveryDestroyCb);
+  }
+  else
+  {
+    delivery->id = g_timeout_add_full(
+        G_PRIORITY_DEFAULT, (delayUs + 999) / 1000, deliverCb, delivery, deliveryDestroyCb);
+  }
+  pending.insert(delivery->id);
+}
+
+void MemoryClipboardBackend::changeOwner(GdkAtom selection, Selection &&owner)
+{
+  auto *previous = selections[selection].source;
+  selections[selection] = move(owner);
+  if (previous != nullptr && previous != selections[selection].source)
+  {
+    previous->clear();
+  }
+
+  if (selection == GDK_SELECTION_CLIPBOARD)
+  {
+    deliver(0, [this]()
+            {
+              if (ownerChangeCallback)
+              {
+                ownerChangeCallback(++selectionTime);
+              }
+            });
+  }
+}
+
+bool MemoryClipboardBackend::read(GdkAtom selection, GdkAtom target, string &contents)
+{
+  auto it = selections.find(selection);
+  if (it == selections.end())
+  {
+    return false;
+  }
+
+  auto &owner = it->second;
+  if (owner.source == nullptr)
+  {
+    auto foreign = owner.foreignData.find(target);
+    if (foreign == owner.foreignData.end())
+    {
+      return false;
+    }
+    contents = foreign->second;
+    return true;
+  }
+
+  for (auto &entry : owner.targets)
+  {
+    if (entry.target != target)
+    {
+      continue;
+    }
+    // Our text is UTF-8 already, which is what every text target converts to.
+    bool found = false;
+    owner.source->get(
+        entry.info,
+        [&contents, &found](const guchar *data, gsize length, bool text, GBytes *bytes)
+        {
+          contents.assign(reinterpret_cast<const char *>(data), length);
+          found = true;
+        });
+    return found;
+  }
+  return false;
+}
+
+void MemoryClipboardBackend::setForeignData(GdkAtom selection, const map<GdkAtom, string> &contents)
+{
+  Selection owner;
+  owner.foreignData = contents;
+  changeOwner(selection, move(owner));
+}
+
+bool MemoryClipboardBackend::reportsOwnerChanges()
+{
+  return true;
+}
+
+void MemoryClipboardBackend::setOwnerChangeCallback(OwnerChangeCallback callback)
+{
+  ownerChangeCallback = move(callback);
+}
+
+void MemoryClipboardBackend::requestTargets(GdkAtom selection, TargetsCallback callback)
+{
+  vector<GdkAtom> atoms;
+  auto it = selections.find(selection);
+  if (it != selections.end())
+  {
+    for (auto &entry : it->second.targets)
+    {
+      atoms.push_back(entry.target);
+    }
+    for (auto &entry : it->second.foreignData)
+    {
+      atoms.push_back(entry.first);
+    }
+  }
+  deliver(0, [atoms, callback]()
+          {
+            callback(atoms.data(), atoms.size());
+          });
+}
+
+void MemoryClipboardBackend::requestContents(
+    GdkAtom selection,
+    GdkAtom target,
+    bool text,
+    ContentsCallback callback)
+{
+  auto contents = make_shared<string>();
+  if (!read(selection, target, *contents))
+  {
+    deliver(0, [callback]()
+            {
+              callback(nullptr, 0, nullptr);
+            });
+    return;
+  }
+  deliver(contents->size(), [contents, callback]()
+          {
+            callback(reinterpret_cast<const guchar *>(contents->data()), contents->size(), nullptr);
+          });
+}
+
+void MemoryClipboardBackend::setData(
+    GdkAtom selection,
+    const GtkTargetEntry *targets,
+    gint numTargets,
+    ClipboardSource *source)
+{
+  Selection owner;
+  owner.source = source;
+  for (gint i = 0; i < numTargets; i++)
+  {
+    owner.targets.push_back({gdk_atom_intern(targets[i].target, FALSE), targets[i].info});
+  }
+  changeOwner(selection, move(owner));
+}
+
+void MemoryClipboardBackend::clear(GdkAtom selection)
+{
+  auto it = selections.find(selection);
+  if (it != selections.end() && it->second.source != nullptr)
+  {
+    changeOwner(selection, Selection());
+  }
+}
+
+void MemoryClipboardBackend::empty(GdkAtom selection)
+{
+  changeOwner(selection, Selection());
+}
+
+void MemoryClipboardBackend::setCanStore(const GtkTargetEntry *targets, gint numTargets) {}
+
+// Plays the clipboard manager: every target is read back from us, and the
+// store succeeds if we still own CLIPBOARD by then.
+void MemoryClipboardBackend::store(const vector<GdkAtom> &targets, StoreCallback callback)
+{
+  auto serial = ++storeSerial;
+  deliver(0, [this, serial, targets, callback]()
+          {
+            auto it = selections.find(GDK_SELECTION_CLIPBOARD);
+            bool stored = serial == storeSerial && it != selections.end() && it->second.source != nullptr;
+            if (stored)
+            {
+              string contents;
+              for (auto target : targets)
+              {
+                read(GDK_SELECTION_CLIPBOARD, target, contents);
+              }
+            }
+            callback(stored ? kStoreOutcomeStored : kStoreOutcomeFailed);
+          });
+}
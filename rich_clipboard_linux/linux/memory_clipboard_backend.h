@@ -0,0 +1,76 @@
+#ifndef RICH_CLIPBOARD_LINUX_MEMORY_CLIPBOARD_BACKEND_H_
+#define RICH_CLIPBOARD_LINUX_MEMORY_CLIPBOARD_BACKEND_H_
+
+#include "clipboard_backend.h"
+
+#include <map>
+#include <set>
+#include <string>
+
+// A clipboard that only exists in this process, for benchmarks that need
+// repeatable timings without an X server or a clipboard manager.
+//
+// Every transfer is answered from the main loop after latencyUs, plus the
+// time its bytes take at bytesPerSecond if that is not 0. Delays are rounded
+// up to whole milliseconds.
+class MemoryClipboardBackend : public ClipboardBackend
+{
+private:
+  struct Target
+  {
+    GdkAtom target;
+    guint info;
+  };
+  // The owner of a selection: either the plugin, through source, or another
+  // application that offers foreignData.
+  struct Selection
+  {
+    ClipboardSource *source = nullptr;
+    std::vector<Target> targets;
+    std::map<GdkAtom, std::string> foreignData;
+  };
+
+  guint latencyUs;
+  guint64 bytesPerSecond;
+  std::map<GdkAtom, Selection> selections;
+  OwnerChangeCallback ownerChangeCallback;
+  guint32 selectionTime = 0;
+  guint storeSerial = 0;
+  // Deliveries that have not run yet.
+  std::set<guint> pending;
+
+  void deliver(gsize length, std::function<void()> callback);
+  void changeOwner(GdkAtom selection, Selection &&owner);
+  // Reads target from the current owner of selection, and returns whether it
+  // offers it.
+  bool read(GdkAtom selection, GdkAtom target, std::string &contents);
+
+  static gboolean deliverCb(gpointer user_data);
+  static void deliveryDestroyCb(gpointer user_data);
+
+public:
+  explicit MemoryClipboardBackend(guint latencyUs = 0, guint64 bytesPerSecond = 0);
+  ~MemoryClipboardBackend() override;
+  MemoryClipboardBackend(const MemoryClipboardBackend &) = delete;
+  MemoryClipboardBackend &operator=(const MemoryClipboardBackend &) = delete;
+
+  // Hands selection to another application, which offers contents under
+  // their targets.
+  void setForeignData(GdkAtom selection, const std::map<GdkAtom, std::string> &contents);
+
+  bool reportsOwnerChanges() override;
+  void setOwnerChangeCallback(OwnerChangeCallback callback) override;
+  void requestTargets(GdkAtom selection, TargetsCallback callback) override;
+  void requestContents(GdkAtom selection, GdkAtom target, bool text, ContentsCallback callback) override;
+  void setData(
+      GdkAtom selection,
+      const GtkTargetEntry *targets,
+      gint numTargets,
+      ClipboardSource *source) override;
+  void clear(GdkAtom selection) override;
+  void empty(GdkAtom selection) override;
+  void setCanStore(const GtkTargetEntry *targets, gint numTargets) override;
+  void store(const std::vector<GdkAtom> &targets, StoreCallback callback) override;
+};
+
+#endif  // RICH_CLIPBOARD_LINUX_MEMORY_CLIPBOARD_BACKEND_H_
@@ -1,210 +1,2921 @@
 #include "include/rich_clipboard_linux/rich_clipboard_plugin.h"
+#include "include/rich_clipboard_linux/rich_clipboard_native.h"
+#include "rich_clipboard_linux_plugin_private.h"
 
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
 #include <sys/utsname.h>
 
+#include <algorithm>
+#include <functional>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <vector>
 #include <cstring>
 
+#include "atom_table.h"
+#include "clipboard_history.h"
+#include "clipboard_image.h"
+#include "clipboard_stats.h"
+#include "clipboard_worker.h"
+#include "content_hash.h"
+#include "gtk_clipboard_backend.h"
+#include "html_decoder.h"
+#include "html_text.h"
+#ifdef RICH_CLIPBOARD_LINUX_WAYLAND
+#include "wayland_clipboard_backend.h"
+#endif
+
 using namespace std;
 
 const char kChannelName[] = "com.bringingfire.rich_clipboard";
+const char kChangesChannelName[] = "com.bringingfire.rich_clipboard/changes";
 const char kGetData[] = "getData";
 const char kSetData[] = "setData";
 const char kGetAvailableTypes[] = "getAvailableTypes";
+const char kGetBinaryData[] = "getBinaryData";
+const char kSetBinaryData[] = "setBinaryData";
+const char kSetFileData[] = "setFileData";
+const char kOpenDataStream[] = "openDataStream";
+const char kReadDataStream[] = "readDataStream";
+const char kCloseDataStream[] = "closeDataStream";
+const char kSetPromisedData[] = "setPromisedData";
+const char kStoreClipboard[] = "storeClipboard";
+const char kGetPrimaryData[] = "getPrimaryData";
+const char kSetPrimaryData[] = "setPrimaryData";
+const char kProvidePromisedData[] = "providePromisedData";
+const char kReleasePromisedData[] = "releasePromisedData";
+const char kGetStats[] = "getStats";
+const char kResetStats[] = "resetStats";
+const char kGetContentFingerprint[] = "getContentFingerprint";
+const char kEnableHistory[] = "enableHistory";
+const char kDisableHistory[] = "disableHistory";
+const char kClearHistory[] = "clearHistory";
+const char kGetHistory[] = "getHistory";
+const char kGetHistoryEntry[] = "getHistoryEntry";
+const char kHasTypes[] = "hasTypes";
+const char kGetImage[] = "getImage";
+const char kSetImage[] = "setImage";
+// The name rich_clipboard_read_data is timed under in getStats.
+const char kNativeReadData[] = "nativeReadData";
 const char kMimeTextPlain[] = "text/plain";
 const char kMimeTextHtml[] = "text/html";
+// The setData argument that asks for plain text to be derived from the HTML.
+const char kDerivePlainText[] = "derivePlainText";
 
 const GdkAtom kGdkAtomTextPlain = gdk_atom_intern_static_string(kMimeTextPlain);
 const GdkAtom kGdkAtomTextHtml = gdk_atom_intern_static_string(kMimeTextHtml);
+const GdkAtom kGdkAtomUtf8String = gdk_atom_intern_static_string("UTF8_STRING");
+const GdkAtom kGdkAtomTextPlainUtf8 = gdk_atom_intern_static_string("text/plain;charset=utf-8");
+
+// Targets that can satisfy each supported MIME type, in order of preference.
+// Every text target listed here is one gtk_selection_data_get_text converts.
+const GdkAtom kTextPlainTargets[] = {
+    kGdkAtomUtf8String,
+    kGdkAtomTextPlainUtf8,
+    gdk_atom_intern_static_string("COMPOUND_TEXT"),
+    gdk_atom_intern_static_string("TEXT"),
+    gdk_atom_intern_static_string("STRING"),
+    gdk_atom_intern_static_string("text/plain"),
+};
+const GdkAtom kTextHtmlTargets[] = {
+    kGdkAtomTextHtml,
+};
+
+// How long a paste may wait for Dart to render a promised format, or for an
+// image to be encoded.
+const guint kPromiseTimeoutMs = 5000;
+// How long rich_clipboard_read_data waits for a transfer, so a caller is not
+// stuck behind an owner that never answers.
+const guint kNativeReadTimeoutMs = 30000;
+// Streams Dart never closes must not pile up. Opening a stream beyond this
+// many drops the oldest, and a stream that is not read from for
+// kDataStreamIdleTimeoutMs is dropped too.
+const guint kMaxDataStreams = 8;
+const guint kDataStreamIdleTimeoutMs = 60000;
+
+// A payload handed to us by Dart, either as a string, as raw bytes, or as a
+// file mapped into memory. It keeps a reference to the FlValue or mapping it
+// arrived in instead of copying it, and measures it once so serving a paste
+// never rescans it. Its hash is likewise only computed once, the first time
+// it is needed.
+class OwnedBuffer
+{
+private:
+  // The FlValue the payload arrived in, or null if it is a mapped file.
+  FlValue *value;
+  // Keeps the payload alive, whichever way it arrived.
+  GBytes *bytes;
+  const guchar *data;
+  gsize length;
+  bool hashed = false;
+  guint64 hash = 0;
+
+public:
+  explicit OwnedBuffer(FlValue *value)
+      : value(fl_value_ref(value))
+  {
+    if (fl_value_get_type(value) == FL_VALUE_TYPE_UINT8_LIST)
+    {
+      data = fl_value_get_uint8_list(value);
+      length = fl_value_get_length(value);
+    }
+    else
+    {
+      data = reinterpret_cast<const guchar *>(fl_value_get_string(value));
+      length = strlen(fl_value_get_string(value));
+    }
+    bytes = g_bytes_new_with_free_func(
+        data, length, reinterpret_cast<GDestroyNotify>(fl_value_unref), fl_value_ref(value));
+  }
+  // Takes the bytes of a mapped file. Pastes are served straight from the
+  // mapping, so the payload only costs page cache.
+  explicit OwnedBuffer(GBytes *bytes)
+      : value(nullptr),
+        bytes(g_bytes_ref(bytes))
+  {
+    data = static_cast<const guchar *>(g_bytes_get_data(bytes, &length));
+  }
+  ~OwnedBuffer()
+  {
+    if (value != nullptr)
+    {
+      fl_value_unref(value);
+    }
+    g_bytes_unref(bytes);
+  }
+  OwnedBuffer(const OwnedBuffer &) = delete;
+  OwnedBuffer &operator=(const OwnedBuffer &) = delete;
+
+  // Returns another buffer over the same payload.
+  OwnedBuffer *share()
+  {
+    return value != nullptr ? new OwnedBuffer(value) : new OwnedBuffer(bytes);
+  }
+  // The payload as GBytes, for readers that may outlive the buffer.
+  GBytes *getBytes()
+  {
+    return bytes;
+  }
+  const guchar *getData()
+  {
+    return data;
+  }
+  gsize getLength()
+  {
+    return length;
+  }
+  // Returns the payload as a string or as bytes. This only copies if it
+  // arrived as the other kind, or as a file.
+  FlValue *newValue(bool binary)
+  {
+    if (value != nullptr && (fl_value_get_type(value) == FL_VALUE_TYPE_UINT8_LIST) == binary)
+    {
+      return fl_value_ref(value);
+    }
+    return binary ? fl_value_new_uint8_list(data, length)
+                  : fl_value_new_string_sized(reinterpret_cast<const gchar *>(data), length);
+  }
+  guint64 getHash()
+  {
+    if (!hashed)
+    {
+      hash = content_hash(data, length);
+      hashed = true;
+    }
+    return hash;
+  }
+  bool equals(OwnedBuffer *other)
+  {
+    if (length != other->length || (hashed && other->hashed && hash != other->hash))
+    {
+      return false;
+    }
+    return memcmp(data, other->data, length) == 0;
+  }
+  static bool canHold(FlValue *value)
+  {
+    auto type = fl_value_get_type(value);
+    return type == FL_VALUE_TYPE_STRING || type == FL_VALUE_TYPE_UINT8_LIST;
+  }
+};
+
+// One format held by RichClipboardData. Its position in the data, plus one,
+// is the target info GTK passes back to the get callback.
+struct ClipboardEntry
+{
+  string mimeType;
+  GdkAtom target;
+  unique_ptr<OwnedBuffer> buffer;
+  // Dart promised to render this format on demand and has not done so yet.
+  bool promised = false;
+  // This is plain text flattened from the HTML format the first time it is
+  // requested, rather than text Dart provided.
+  bool derived = false;
+  // This is the image Dart provided, encoded in this format the first time it
+  // is requested.
+  bool encoded = false;
+  // Callbacks waiting for Dart to finish rendering this format.
+  vector<function<void()>> renderWaiters;
+};
+
+class RichClipboardData : public ClipboardSource
+{
+private:
+  vector<unique_ptr<ClipboardEntry>> entries;
+  // The format of the image the encoded formats are produced from.
+  string imageType;
+  FlValue *types = nullptr;
+  vector<GdkAtom> targets;
+  guint holds = 0;
+  bool cleared = false;
+
+  ClipboardEntry *findEntry(const gchar *mimeType)
+  {
+    for (auto &entry : entries)
+    {
+      if (entry->mimeType == mimeType)
+      {
+        return entry.get();
+      }
+    }
+    return nullptr;
+  }
+  ClipboardEntry *addEntry(const gchar *mimeType)
+  {
+    auto *entry = findEntry(mimeType);
+    if (entry == nullptr)
+    {
+      entry = new ClipboardEntry();
+      entry->mimeType = mimeType;
+      entry->target = gdk_atom_intern(mimeType, FALSE);
+      entries.emplace_back(entry);
+    }
+    return entry;
+  }
+
+public:
+  // The plugin that installed this data, or null once it has been detached.
+  // Lets reads be served from memory while we own the clipboard.
+  FlRichClipboardPlugin *owner = nullptr;
+
+  // Identifies the Dart provider of the promised formats, or 0 if there are
+  // none.
+  gint64 promiseId = 0;
+
+  ~RichClipboardData()
+  {
+    if (types != nullptr)
+    {
+      fl_value_unref(types);
+    }
+  }
+  ClipboardEntry *getEntry(guint info)
+  {
+    return info >= 1 && info <= entries.size() ? entries[info - 1].get() : nullptr;
+  }
+  OwnedBuffer *getBuffer(const gchar *mimeType)
+  {
+    auto *entry = findEntry(mimeType);
+    return entry != nullptr ? entry->buffer.get() : nullptr;
+  }
+  void set(const gchar *mimeType, FlValue *value)
+  {
+    addEntry(mimeType)->buffer.reset(new OwnedBuffer(value));
+  }
+  void set(const gchar *mimeType, GBytes *bytes)
+  {
+    addEntry(mimeType)->buffer.reset(new OwnedBuffer(bytes));
+  }
+  // Records that the format is only rendered once requested.
+  void promise(const gchar *mimeType)
+  {
+    addEntry(mimeType)->promised = true;
+  }
+  // Offers plain text that is only flattened from the HTML once requested.
+  void derivePlainText()
+  {
+    addEntry(kMimeTextPlain)->derived = true;
+  }
+  // Holds image in mimeType, and offers it in each of encodings as well.
+  // Those are only encoded once requested.
+  void setImage(const gchar *mimeType, FlValue *image, const vector<string> &encodings)
+  {
+    set(mimeType, image);
+    imageType = mimeType;
+    for (auto &encoding : encodings)
+    {
+      if (encoding != mimeType)
+      {
+        addEntry(encoding.c_str())->encoded = true;
+      }
+    }
+  }
+  OwnedBuffer *getImage()
+  {
+    return imageType.empty() ? nullptr : getBuffer(imageType.c_str());
+  }
+  const string &getImageType()
+  {
+    return imageType;
+  }
+  // Whether target is an encoding of the image that is only produced once
+  // requested.
+  bool isEncoded(const gchar *target)
+  {
+    auto *entry = findEntry(target);
+    return entry != nullptr && entry->encoded;
+  }
+  // The infos of the derived and encoded formats among mimeTypes that have
+  // not been built yet.
+  vector<guint> getUnbuiltInfos(const vector<string> &mimeTypes)
+  {
+    vector<guint> infos;
+    for (guint i = 0; i < entries.size(); i++)
+    {
+      auto &entry = entries[i];
+      if ((entry->derived || entry->encoded) && entry->buffer == nullptr &&
+          find(mimeTypes.begin(), mimeTypes.end(), entry->mimeType) != mimeTypes.end())
+      {
+        infos.push_back(i + 1);
+      }
+    }
+    return infos;
+  }
+  // Stores text flattened from the HTML in entry, unless it was built in the
+  // meantime.
+  void setDerived(ClipboardEntry *entry, const string &text)
+  {
+    if (entry->buffer == nullptr)
+    {
+      g_autoptr(FlValue) value = fl_value_new_string_sized(text.data(), text.size());
+      entry->buffer.reset(new OwnedBuffer(value));
+    }
+  }
+  // Stores an encoding of the image in entry, or gives up on the format if
+  // encoding failed.
+  void setEncoded(ClipboardEntry *entry, GBytes *bytes)
+  {
+    if (bytes == nullptr)
+    {
+      entry->encoded = false;
+    }
+    else if (entry->buffer == nullptr)
+    {
+      entry->buffer.reset(new OwnedBuffer(bytes));
+    }
+  }
+  // Flattens the HTML into entry if it is derived and has not been built yet.
+  // Returns whether it was built now.
+  bool buildDerived(ClipboardEntry *entry)
+  {
+    if (!entry->derived || entry->buffer != nullptr)
+    {
+      return false;
+    }
+    auto *html = getBuffer(kMimeTextHtml);
+    if (html == nullptr)
+    {
+      return false;
+    }
+    setDerived(entry, html_to_text(reinterpret_cast<const gchar *>(html->getData()), html->getLength()));
+    return true;
+  }
+  // Like getBuffer, but builds derived text first.
+  OwnedBuffer *getBuiltBuffer(const gchar *mimeType)
+  {
+    auto *entry = findEntry(mimeType);
+    if (entry == nullptr)
+    {
+      return nullptr;
+    }
+    buildDerived(entry);
+    return entry->buffer.get();
+  }
+  // The infos of the promised formats among mimeTypes that Dart has not
+  // rendered yet.
+  vector<guint> getPromisedInfos(const vector<string> &mimeTypes)
+  {
+    vector<guint> infos;
+    for (guint i = 0; i < entries.size(); i++)
+    {
+      auto &entry = entries[i];
+      if (entry->promised && find(mimeTypes.begin(), mimeTypes.end(), entry->mimeType) != mimeTypes.end())
+      {
+        infos.push_back(i + 1);
+      }
+    }
+    return infos;
+  }
+  // Adds a target for every format. Plain text is offered under all of the
+  // text targets GTK knows how to convert to.
+  void addTargets(GtkTargetList *targetList)
+  {
+    for (guint i = 0; i < entries.size(); i++)
+    {
+      auto &entry = entries[i];
+      if (entry->mimeType == kMimeTextPlain)
+      {
+        gtk_target_list_add_text_targets(targetList, i + 1);
+      }
+      else
+      {
+        gtk_target_list_add(targetList, entry->target, 0, i + 1);
+      }
+    }
+  }
+  // Calls callback with every format that holds bytes.
+  void forEachBuffer(const function<void(const string &mimeType, OwnedBuffer *buffer)> &callback)
+  {
+    for (auto &entry : entries)
+    {
+      if (entry->buffer != nullptr)
+      {
+        callback(entry->mimeType, entry->buffer.get());
+      }
+    }
+  }
+  // Hashes the text format mimeType as another application would read it,
+  // flattening derived text first, and sets present to whether it is
+  // offered at all. Returns false if Dart has not rendered it yet.
+  bool hashText(const gchar *mimeType, bool &present, guint64 &hash)
+  {
+    auto *entry = findEntry(mimeType);
+    present = entry != nullptr;
+    if (entry == nullptr)
+    {
+      return true;
+    }
+    buildDerived(entry);
+    if (entry->buffer == nullptr)
+    {
+      return false;
+    }
+    hash = entry->buffer->getHash();
+    return true;
+  }
+  // Whether other holds exactly the same formats and bytes.
+  bool hasSameContent(RichClipboardData *other)
+  {
+    if (entries.size() != other->entries.size())
+    {
+      return false;
+    }
+    for (auto &entry : entries)
+    {
+      auto *otherEntry = other->findEntry(entry->mimeType.c_str());
+      if (otherEntry == nullptr || entry->derived != otherEntry->derived || entry->encoded != otherEntry->encoded)
+      {
+        return false;
+      }
+      // Derived text and encoded images are the same if what they are built
+      // from is.
+      if (entry->derived || entry->encoded)
+      {
+        continue;
+      }
+      auto *otherBuffer = otherEntry->buffer.get();
+      if (entry->buffer == nullptr || otherBuffer == nullptr || !entry->buffer->equals(otherBuffer))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  // Switches every format whose bytes match the same format of other over to
+  // other's buffer, so the two keep a single copy between them.
+  void shareBuffersWith(RichClipboardData *other)
+  {
+    for (auto &entry : entries)
+    {
+      auto *otherBuffer = other->getBuffer(entry->mimeType.c_str());
+      if (entry->buffer != nullptr && otherBuffer != nullptr &&
+          entry->buffer->getData() != otherBuffer->getData() && entry->buffer->equals(otherBuffer))
+      {
+        entry->buffer.reset(otherBuffer->share());
+      }
+    }
+  }
+  // Keeps the data alive while a render is in flight. The backend may clear
+  // the clipboard meanwhile, in which case deletion waits for the last
+  // release.
+  void hold()
+  {
+    holds++;
+  }
+  void release()
+  {
+    if (--holds == 0 && cleared)
+    {
+      delete this;
+    }
+  }
+  void get(guint info, const Writer &write) override;
+  void clear() override;
+  // The names of the targets advertised for this data, as getAvailableTypes
+  // reports them.
+  FlValue *getTypes()
+  {
+    return types;
+  }
+  // The targets advertised for this data, which types names.
+  const vector<GdkAtom> &getTargets()
+  {
+    return targets;
+  }
+  void setTypes(AtomTable *atomTable, const GtkTargetEntry *targetTable, gint numTargets)
+  {
+    targets.clear();
+    for (gint i = 0; i < numTargets; i++)
+    {
+      targets.push_back(atomTable->intern(targetTable[i].target));
+    }
+    if (types != nullptr)
+    {
+      fl_value_unref(types);
+    }
+    types = atomTable->newTypesValue(targets.data(), targets.size());
+  }
+  // Builds the map of MIME type to payload for the given types, with the
+  // payloads as strings for getData or as bytes for getBinaryData.
+  FlValue *toValue(const vector<string> &mimeTypes, bool binary)
+  {
+    auto *value = fl_value_new_map();
+    for (auto &mimeType : mimeTypes)
+    {
+      auto *buffer = getBuiltBuffer(mimeType.c_str());
+      if (buffer != nullptr)
+      {
+        fl_value_set_string_take(value, mimeType.c_str(), buffer->newValue(binary));
+      }
+    }
+    return value;
+  }
+  bool isEmpty()
+  {
+    for (auto &entry : entries)
+    {
+      if (entry->buffer != nullptr || entry->promised)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool isNotEmpty()
+  {
+    return !isEmpty();
+  }
+};
+
+// The formats getData reads and returns as strings.
+const vector<string> kStringTypes = {kMimeTextPlain, kMimeTextHtml};
+
+// The shortest interval between two updates of the PRIMARY selection. Dart
+// may report every step of a selection drag, but only the latest selection is
+// published, at most this often.
+const guint kPrimaryIntervalMs = 50;
+
+// Progress of handing the data we own to the clipboard manager.
+enum StoreState
+{
+  kStoreIdle,
+  kStoreRunning,
+  kStoreDone,
+  kStoreFailed,
+};
+
+struct _FlRichClipboardPlugin
+{
+  GObject parent_instance;
+
+  FlPluginRegistrar *registrar;
+
+  // Connection to Flutter engine.
+  FlMethodChannel *channel;
+  FlEventChannel *changesChannel;
+
+  ClipboardBackend *backend;
+
+  // Whether the backend reports owner changes. Without them a
+  // snapshot of another application's data can never be invalidated, so
+  // nothing is cached.
+  gboolean canCacheSnapshot;
+
+  // Bumped on every owner change. Reads that started under an older
+  // generation must not populate the snapshot.
+  guint64 generation;
+
+  // Snapshot of the last decoded reads, valid until the owner changes.
+  // cachedData maps each text type read so far to its value, or to null if
+  // the owner did not provide it.
+  FlValue *cachedTypes;
+  FlValue *cachedData;
+  // The targets cachedTypes names, which hasTypes matches without them.
+  vector<GdkAtom> *cachedTargets;
+
+  // The names of the targets owners advertised so far.
+  AtomTable *atoms;
+
+  // The data we put on CLIPBOARD while we still own it.
+  RichClipboardData *ownedData;
+
+  // Whether Dart listens to the changes channel.
+  gboolean listening;
+  guint64 changeSequence;
+  guint32 lastChangeSelectionTime;
+  // A TARGETS request for a change event is in flight. If another change
+  // arrives meanwhile the result is stale and the request is repeated, so
+  // only the latest state is reported.
+  gboolean changeTargetsPending;
+  gboolean changeTargetsStale;
+  guint64 changeGeneration;
+
+  // DataStreams opened with openDataStream, keyed by id, that Dart reads in
+  // chunks until it closes them.
+  GHashTable *streams;
+  guint nextStreamId;
+
+  // The clipboard manager handoff of the data we own. storeSerial identifies
+  // the latest handoff, and storeCalls are the storeClipboard calls waiting
+  // for its outcome.
+  StoreState storeState;
+  guint storeSerial;
+  GPtrArray *storeCalls;
+
+  // The PRIMARY selection, which holds whatever is selected rather than what
+  // was copied. primaryData is the selection we own, and pendingPrimary the
+  // latest one Dart set that is waiting for primaryTimeout to publish it.
+  RichClipboardData *primaryData;
+  RichClipboardData *pendingPrimary;
+  guint primaryTimeout;
+
+  // A write to CLIPBOARD that has not claimed ownership yet, and the set
+  // calls it answers. A burst of writes only installs the last one, see
+  // fl_rich_clipboard_plugin_queue_write.
+  RichClipboardData *pendingData;
+  GPtrArray *pendingCalls;
+  guint flushSource;
 
-const guint kUserInfoTextPlain = 1;
-const guint kUserInfoTextHtml = 2;
+  // What getStats reports.
+  ClipboardStats *stats;
 
-class RichClipboardData
+  // The rich_clipboard_read_data calls this plugin is serving, which fail if
+  // it goes away first.
+  GPtrArray *nativeReads;
+
+  // Snapshots of what CLIPBOARD held, taken on every owner change while Dart
+  // has the history enabled, and null otherwise.
+  ClipboardHistory *history;
+};
+
+// State shared by the asynchronous callbacks of a single method call.
+class PluginRequest
+{
+protected:
+  FlRichClipboardPlugin *plugin;
+  FlMethodCall *methodCall;
+  guint64 generation;
+
+public:
+  PluginRequest(FlRichClipboardPlugin *plugin, FlMethodCall *methodCall)
+      : plugin(FL_MY_PLUGIN_PLUGIN(g_object_ref(plugin))),
+        methodCall(FL_METHOD_CALL(g_object_ref(methodCall))),
+        generation(plugin->generation)
+  {
+  }
+  virtual ~PluginRequest()
+  {
+    g_object_unref(methodCall);
+    g_object_unref(plugin);
+  }
+  FlRichClipboardPlugin *getPlugin()
+  {
+    return plugin;
+  }
+  // Whether a result read for this request may be stored in the snapshot.
+  bool canCacheResult()
+  {
+    return plugin->canCacheSnapshot && plugin->generation == generation;
+  }
+  void respond(FlValue *result)
+  {
+    g_autoptr(GError) error = nullptr;
+    if (!fl_method_call_respond_success(methodCall, result, &error))
+      g_warning("Failed to send method call response: %s", error->message);
+  }
+};
+
+// Builds the string getData returns for a transfer of mimeType. HTML arrives
+// in whatever encoding the owner chose, and getData returns UTF-8.
+//
+// This runs on a worker for large transfers, so it must not use GTK.
+static FlValue *new_string_value(const string &mimeType, const gchar *targetName, const guchar *data, gsize length)
+{
+  string decoded;
+  if (mimeType == kMimeTextHtml && decode_html(data, length, targetName, decoded))
+  {
+    return fl_value_new_string_sized(decoded.data(), decoded.size());
+  }
+  return fl_value_new_string_sized(reinterpret_cast<const gchar *>(data), length);
+}
+
+// A transfer decoded on a worker. targetName and data are its input, and
+// value its result.
+struct DecodeJob
+{
+  string targetName;
+  string data;
+  FlValue *value = nullptr;
+};
+
+// Collects the results of the asynchronous transfers started for a single
+// getData or getBinaryData call and answers the method call once the last one
+// has finished.
+class GetDataRequest : public PluginRequest
 {
 private:
-  unique_ptr<string> textPlain;
-  unique_ptr<string> textHtml;
+  vector<string> mimeTypes;
+  bool binary;
+  FlValue *result;
+  guint pending;
 
 public:
-  string *getTextPlain()
+  // Whether the result may go into the snapshot, which only covers the
+  // CLIPBOARD selection.
+  bool cacheable = true;
+
+  // The request starts with one pending step for the TARGETS negotiation. It
+  // is only released once every transfer has been started, so a transfer that
+  // GTK completes synchronously cannot answer the call early.
+  //
+  // mimeTypes are the types to transfer. Values already known from the
+  // snapshot can be passed in known, and are included in the response.
+  GetDataRequest(
+      FlRichClipboardPlugin *plugin,
+      FlMethodCall *methodCall,
+      const vector<string> &mimeTypes,
+      bool binary,
+      FlValue *known = nullptr)
+      : PluginRequest(plugin, methodCall),
+        mimeTypes(mimeTypes),
+        binary(binary),
+        result(known != nullptr ? fl_value_ref(known) : fl_value_new_map()),
+        pending(1)
+  {
+  }
+  ~GetDataRequest()
   {
-    return textPlain.get();
+    fl_value_unref(result);
+  }
+  const vector<string> &getMimeTypes()
+  {
+    return mimeTypes;
+  }
+  // Adds a transfer to the result. data is only valid during the call.
+  void addResult(const string &mimeType, GdkAtom target, const guchar *data, gsize length)
+  {
+    plugin->stats->recordRead(mimeType, length);
+    if (binary)
+    {
+      fl_value_set_string_take(result, mimeType.c_str(), fl_value_new_uint8_list(data, length));
+      return;
+    }
+    auto &targetName = plugin->atoms->getName(target);
+    if (mimeType != kMimeTextHtml || length < kWorkerMinLength)
+    {
+      fl_value_set_string_take(
+          result, mimeType.c_str(), new_string_value(mimeType, targetName.c_str(), data, length));
+      return;
+    }
+
+    // Decoding a large document would hold up the main loop, so it is done
+    // on a worker, on a copy of the transfer.
+    auto job = make_shared<DecodeJob>();
+    job->targetName = targetName;
+    job->data.assign(reinterpret_cast<const gchar *>(data), length);
+    addTransfer();
+    run_on_worker(
+        [mimeType, job]()
+        {
+          job->value = new_string_value(
+              mimeType, job->targetName.c_str(),
+              reinterpret_cast<const guchar *>(job->data.data()), job->data.size());
+        },
+        [this, mimeType, job]()
+        {
+          fl_value_set_string_take(result, mimeType.c_str(), job->value);
+          complete();
+        });
+  }
+  void addTransfer()
+  {
+    pending++;
+  }
+  // Marks one step as finished. The request deletes itself after
+  // responding, so it must not be used after the last call to this.
+  void complete()
+  {
+    if (--pending > 0)
+    {
+      return;
+    }
+    if (!binary && cacheable && canCacheResult())
+    {
+      if (plugin->cachedData == nullptr)
+      {
+        plugin->cachedData = fl_value_new_map();
+      }
+      for (auto &mimeType : mimeTypes)
+      {
+        auto *value = fl_value_lookup_string(result, mimeType.c_str());
+        fl_value_set_string_take(
+            plugin->cachedData,
+            mimeType.c_str(),
+            value != nullptr ? fl_value_ref(value) : fl_value_new_null());
+      }
+    }
+    respond(result);
+    delete this;
+  }
+};
+
+G_DEFINE_TYPE(FlRichClipboardPlugin, fl_rich_clipboard_plugin, g_object_get_type())
+
+// The plugin that serves rich_clipboard_read_data, the one created last. It is
+// only used on the main thread.
+static FlRichClipboardPlugin *nativePlugin = nullptr;
+
+// A method call whose latency is recorded once it has been answered.
+struct TimedCall
+{
+  FlRichClipboardPlugin *plugin;
+  string method;
+  gint64 start;
+};
+
+static void timed_call_finalized_cb(gpointer user_data, GObject *method_call)
+{
+  unique_ptr<TimedCall> call(static_cast<TimedCall *>(user_data));
+  if (call->plugin->stats != nullptr)
+  {
+    call->plugin->stats->recordCall(call->method, g_get_monotonic_time() - call->start);
+  }
+  g_object_unref(call->plugin);
+}
+
+// Records how long method_call takes. Every path that answers a call lets go
+// of it right after responding, so the call is timed until it is released
+// rather than at each of those paths.
+static void fl_rich_clipboard_plugin_time_call(FlRichClipboardPlugin *self, FlMethodCall *method_call)
+{
+  auto *call = new TimedCall{
+      FL_MY_PLUGIN_PLUGIN(g_object_ref(self)),
+      fl_method_call_get_name(method_call),
+      g_get_monotonic_time(),
+  };
+  g_object_weak_ref(G_OBJECT(method_call), timed_call_finalized_cb, call);
+}
+
+// Records the bytes of a write from Dart, including ones a later write
+// replaces before they are installed.
+static void fl_rich_clipboard_plugin_record_writes(FlRichClipboardPlugin *self, RichClipboardData *clipboardData)
+{
+  clipboardData->forEachBuffer(
+      [self](const string &mimeType, OwnedBuffer *buffer)
+      {
+        self->stats->recordWrite(mimeType, buffer->getLength());
+      });
+}
+
+// Records the size of the data we own on CLIPBOARD and PRIMARY, counting
+// payloads the two share once.
+static void fl_rich_clipboard_plugin_record_owned_bytes(FlRichClipboardPlugin *self)
+{
+  set<const guchar *> seen;
+  gsize length = 0;
+  for (auto *clipboardData : {self->ownedData, self->primaryData})
+  {
+    if (clipboardData == nullptr)
+    {
+      continue;
+    }
+    clipboardData->forEachBuffer(
+        [&seen, &length](const string &mimeType, OwnedBuffer *buffer)
+        {
+          if (seen.insert(buffer->getData()).second)
+          {
+            length += buffer->getLength();
+          }
+        });
+  }
+  self->stats->recordOwnedBytes(length);
+}
+
+// Keeps the targets of another application's data, named by types, until
+// the owner changes.
+static void fl_rich_clipboard_plugin_cache_targets(
+    FlRichClipboardPlugin *self,
+    FlValue *types,
+    const GdkAtom *atoms,
+    gint n_atoms)
+{
+  g_clear_pointer(&self->cachedTypes, fl_value_unref);
+  self->cachedTypes = fl_value_ref(types);
+  delete self->cachedTargets;
+  self->cachedTargets = new vector<GdkAtom>(atoms, atoms + n_atoms);
+}
+
+static void fl_rich_clipboard_plugin_types_received(
+    PluginRequest *request,
+    const GdkAtom *atoms,
+    gint n_atoms)
+{
+  auto *plugin = request->getPlugin();
+  g_autoptr(FlValue) result = plugin->atoms->newTypesValue(atoms, n_atoms);
+  if (request->canCacheResult())
+  {
+    fl_rich_clipboard_plugin_cache_targets(plugin, result, atoms, n_atoms);
+  }
+  request->respond(result);
+}
+
+// Returns the first of the preferred targets that the owner advertises, or
+// GDK_NONE if it offers none of them.
+static GdkAtom find_preferred_target(
+    const GdkAtom *preferred,
+    gsize n_preferred,
+    const GdkAtom *atoms,
+    gint n_atoms)
+{
+  for (gsize i = 0; i < n_preferred; i++)
+  {
+    for (gint j = 0; j < n_atoms; j++)
+    {
+      if (atoms[j] == preferred[i])
+      {
+        return preferred[i];
+      }
+    }
+  }
+  return GDK_NONE;
+}
+
+// Returns the best advertised target to fetch mimeType with, or GDK_NONE.
+// text/html falls back to a text/html target with parameters.
+static GdkAtom find_target_for_type(
+    AtomTable *atomTable,
+    const string &mimeType,
+    const GdkAtom *atoms,
+    gint n_atoms)
+{
+  if (mimeType == kMimeTextPlain)
+  {
+    return find_preferred_target(kTextPlainTargets, G_N_ELEMENTS(kTextPlainTargets), atoms, n_atoms);
+  }
+  if (mimeType == kMimeTextHtml)
+  {
+    auto target = find_preferred_target(kTextHtmlTargets, G_N_ELEMENTS(kTextHtmlTargets), atoms, n_atoms);
+    for (gint i = 0; target == GDK_NONE && i < n_atoms; i++)
+    {
+      if (is_html_target_with_parameters(atomTable->getName(atoms[i]).c_str()))
+      {
+        target = atoms[i];
+      }
+    }
+    return target;
+  }
+  auto atom = atomTable->intern(mimeType);
+  return find_preferred_target(&atom, 1, atoms, n_atoms);
+}
+
+// The most types a single hasTypes call can ask about, one per bit of its
+// result.
+const gsize kMaxHasTypes = 64;
+
+// Returns the hasTypes bitmask of mimeTypes, with bit i set if the targets
+// can satisfy mimeTypes[i] the way getData or getBinaryData would read it.
+static gint64 match_types(
+    AtomTable *atomTable,
+    const vector<string> &mimeTypes,
+    const GdkAtom *atoms,
+    gint n_atoms)
+{
+  guint64 mask = 0;
+  for (gsize i = 0; i < mimeTypes.size(); i++)
+  {
+    if (find_target_for_type(atomTable, mimeTypes[i], atoms, n_atoms) != GDK_NONE)
+    {
+      mask |= G_GUINT64_CONSTANT(1) << i;
+    }
+  }
+  return static_cast<gint64>(mask);
+}
+
+// Answers hasTypes from the targets we advertise, the snapshot, or else a
+// TARGETS request, whose result goes into the snapshot.
+static void fl_rich_clipboard_plugin_has_types(
+    FlRichClipboardPlugin *self,
+    FlMethodCall *method_call,
+    const vector<string> &mimeTypes)
+{
+  const vector<GdkAtom> *targets = nullptr;
+  if (self->ownedData != nullptr)
+  {
+    targets = &self->ownedData->getTargets();
+  }
+  else if (self->cachedTargets != nullptr)
+  {
+    targets = self->cachedTargets;
+  }
+  if (targets != nullptr)
+  {
+    g_autoptr(FlValue) result =
+        fl_value_new_int(match_types(self->atoms, mimeTypes, targets->data(), targets->size()));
+    fl_method_call_respond_success(method_call, result, nullptr);
+    return;
+  }
+
+  auto *request = new PluginRequest(self, method_call);
+  self->backend->requestTargets(
+      GDK_SELECTION_CLIPBOARD,
+      [request, mimeTypes](const GdkAtom *atoms, gint n_atoms)
+      {
+        unique_ptr<PluginRequest> finished(request);
+        auto *plugin = finished->getPlugin();
+        if (finished->canCacheResult())
+        {
+          g_autoptr(FlValue) types = plugin->atoms->newTypesValue(atoms, n_atoms);
+          fl_rich_clipboard_plugin_cache_targets(plugin, types, atoms, n_atoms);
+        }
+        g_autoptr(FlValue) result = fl_value_new_int(match_types(plugin->atoms, mimeTypes, atoms, n_atoms));
+        finished->respond(result);
+      });
+}
+
+// Transfers the types of request from selection.
+static void fl_rich_clipboard_plugin_read_data(
+    FlRichClipboardPlugin *self,
+    GdkAtom selection,
+    GetDataRequest *request)
+{
+  auto *backend = self->backend;
+  auto *atomTable = self->atoms;
+  backend->requestTargets(
+      selection,
+      [backend, atomTable, selection, request](const GdkAtom *atoms, gint n_atoms)
+      {
+        // Only fetch targets the owner actually offers. Asking for a missing
+        // target costs a full round trip, and GTK may answer with a different
+        // type.
+        for (auto &mimeType : request->getMimeTypes())
+        {
+          auto target = find_target_for_type(atomTable, mimeType, atoms, n_atoms);
+          if (target == GDK_NONE)
+          {
+            continue;
+          }
+
+          // Text targets come in several encodings that the backend converts
+          // to UTF-8.
+          request->addTransfer();
+          backend->requestContents(
+              selection,
+              target,
+              mimeType == kMimeTextPlain,
+              [request, mimeType, target](const guchar *data, gsize length, GBytes *bytes)
+              {
+                if (data != nullptr)
+                {
+                  request->addResult(mimeType, target, data, length);
+                }
+                request->complete();
+              });
+        }
+
+        request->complete();
+      });
+}
+
+// A render of a promised format that is waiting for Dart's response.
+struct PromiseCall
+{
+  RichClipboardData *clipboardData;
+  guint info;
+};
+
+static void promise_response_cb(GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  unique_ptr<PromiseCall> call(static_cast<PromiseCall *>(user_data));
+  auto *clipboardData = call->clipboardData;
+  auto *entry = clipboardData->getEntry(call->info);
+
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(FlMethodResponse) response =
+      fl_method_channel_invoke_method_finish(FL_METHOD_CHANNEL(object), result, &error);
+  FlValue *value = response != nullptr ? fl_method_response_get_result(response, &error) : nullptr;
+  if (value != nullptr)
+  {
+    // A null result means Dart has nothing for this format after all.
+    if (OwnedBuffer::canHold(value))
+    {
+      entry->buffer.reset(new OwnedBuffer(value));
+      auto *owner = clipboardData->owner;
+      if (owner != nullptr)
+      {
+        owner->stats->recordWrite(entry->mimeType, entry->buffer->getLength());
+        fl_rich_clipboard_plugin_record_owned_bytes(owner);
+      }
+    }
+    entry->promised = false;
+  }
+  else
+  {
+    g_warning("Failed to render promised clipboard data: %s", error->message);
+  }
+
+  auto waiters = move(entry->renderWaiters);
+  entry->renderWaiters.clear();
+  for (auto &waiter : waiters)
+  {
+    waiter();
+  }
+  clipboardData->release();
+}
+
+// Asks Dart to render a promised format and calls done once it has answered
+// or failed. Concurrent requests for the same format share one render.
+static void fl_rich_clipboard_plugin_render_promise(
+    FlRichClipboardPlugin *self,
+    RichClipboardData *clipboardData,
+    guint info,
+    function<void()> done)
+{
+  auto *entry = clipboardData->getEntry(info);
+  entry->renderWaiters.push_back(done);
+  if (entry->renderWaiters.size() > 1)
+  {
+    return;
+  }
+
+  clipboardData->hold();
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "id", fl_value_new_int(clipboardData->promiseId));
+  fl_value_set_string_take(args, "type", fl_value_new_string(entry->mimeType.c_str()));
+  fl_method_channel_invoke_method(
+      self->channel,
+      kProvidePromisedData,
+      args,
+      nullptr,
+      promise_response_cb,
+      new PromiseCall{clipboardData, info});
+}
+
+static gboolean promise_timeout_cb(gpointer user_data)
+{
+  *static_cast<bool *>(user_data) = true;
+  return G_SOURCE_REMOVE;
+}
+
+// Spins the main loop until finished is set, for at most kPromiseTimeoutMs.
+// Returns false if it timed out.
+static bool fl_rich_clipboard_plugin_wait_until(const shared_ptr<bool> &finished)
+{
+  bool timedOut = false;
+  auto timeoutId = g_timeout_add(kPromiseTimeoutMs, promise_timeout_cb, &timedOut);
+  while (!*finished && !timedOut)
+  {
+    g_main_context_iteration(nullptr, TRUE);
+  }
+  if (!timedOut)
+  {
+    g_source_remove(timeoutId);
+  }
+  return !timedOut;
+}
+
+// GTK expects the selection data to be filled in before the get callback
+// returns, so a paste of a promised format spins the main loop until Dart has
+// rendered it. This only happens on the first request for each format.
+static void fl_rich_clipboard_plugin_wait_for_promise(
+    FlRichClipboardPlugin *self,
+    RichClipboardData *clipboardData,
+    guint info)
+{
+  auto finished = make_shared<bool>(false);
+  fl_rich_clipboard_plugin_render_promise(
+      self, clipboardData, info,
+      [finished]()
+      {
+        *finished = true;
+      });
+  if (!fl_rich_clipboard_plugin_wait_until(finished))
+  {
+    g_warning("Timed out waiting for promised clipboard data");
+  }
+}
+
+// Encodes the image of clipboardData into the format registered with info on
+// a worker, and calls done once it is stored.
+static void fl_rich_clipboard_plugin_encode_image(
+    RichClipboardData *clipboardData,
+    guint info,
+    function<void()> done)
+{
+  auto *image = clipboardData->getImage();
+  if (image == nullptr)
+  {
+    done();
+    return;
+  }
+
+  clipboardData->hold();
+  auto *source = g_bytes_ref(image->getBytes());
+  auto sourceType = clipboardData->getImageType();
+  ImageOptions options;
+  options.mimeType = clipboardData->getEntry(info)->mimeType;
+  auto result = make_shared<ConvertedImage>();
+  auto error = make_shared<GError *>(nullptr);
+  run_on_worker(
+      [source, sourceType, options, result, error]()
+      {
+        convert_image(source, sourceType, options, *result, error.get());
+      },
+      [clipboardData, info, source, result, error, done]()
+      {
+        if (*error != nullptr)
+        {
+          g_warning("Failed to encode clipboard image: %s", (*error)->message);
+          g_error_free(*error);
+        }
+        clipboardData->setEncoded(clipboardData->getEntry(info), result->bytes);
+        if (result->bytes != nullptr)
+        {
+          g_bytes_unref(result->bytes);
+        }
+        auto *owner = clipboardData->owner;
+        if (owner != nullptr)
+        {
+          fl_rich_clipboard_plugin_record_owned_bytes(owner);
+        }
+        g_bytes_unref(source);
+        done();
+        clipboardData->release();
+      });
+}
+
+// Like a promise, an image is encoded while a paste waits for it, on a worker
+// so the main loop keeps running meanwhile. A paste that times out gets
+// nothing, and the encoding is kept for the next paste once it is done.
+static void fl_rich_clipboard_plugin_wait_for_encoding(RichClipboardData *clipboardData, guint info)
+{
+  auto finished = make_shared<bool>(false);
+  fl_rich_clipboard_plugin_encode_image(
+      clipboardData, info,
+      [finished]()
+      {
+        *finished = true;
+      });
+  if (!fl_rich_clipboard_plugin_wait_until(finished))
+  {
+    g_warning("Timed out encoding clipboard image");
+  }
+}
+
+void RichClipboardData::get(guint info, const Writer &write)
+{
+  auto *entry = getEntry(info);
+  if (entry == nullptr)
+  {
+    return;
+  }
+
+  // Waiting for a promise or an encoding runs the main loop, during which the
+  // backend may clear the clipboard.
+  hold();
+  if (entry->promised && owner != nullptr)
+  {
+    fl_rich_clipboard_plugin_wait_for_promise(owner, this, info);
+  }
+
+  if (buildDerived(entry) && owner != nullptr)
+  {
+    fl_rich_clipboard_plugin_record_owned_bytes(owner);
+  }
+  if (entry->encoded && entry->buffer == nullptr)
+  {
+    fl_rich_clipboard_plugin_wait_for_encoding(this, info);
+  }
+
+  // There is nothing to serve if Dart could not render a promised format.
+  auto *buffer = entry->buffer.get();
+  if (buffer != nullptr)
+  {
+    if (owner != nullptr)
+    {
+      owner->stats->recordPaste(entry->mimeType, buffer->getLength());
+    }
+    write(buffer->getData(), buffer->getLength(), entry->mimeType == kMimeTextPlain, buffer->getBytes());
+  }
+  release();
+}
+
+// Drops the snapshot and makes reads that are still in flight stale.
+static void fl_rich_clipboard_plugin_invalidate_snapshot(FlRichClipboardPlugin *self)
+{
+  self->generation++;
+  g_clear_pointer(&self->cachedTypes, fl_value_unref);
+  g_clear_pointer(&self->cachedData, fl_value_unref);
+  delete self->cachedTargets;
+  self->cachedTargets = nullptr;
+}
+
+// Called when the backend no longer needs the data.
+void RichClipboardData::clear()
+{
+  if (owner != nullptr)
+  {
+    if (owner->ownedData == this)
+    {
+      owner->ownedData = nullptr;
+    }
+    if (owner->primaryData == this)
+    {
+      owner->primaryData = nullptr;
+    }
+    // Let Dart drop its provider, and whatever document it keeps alive.
+    if (promiseId != 0)
+    {
+      g_autoptr(FlValue) args = fl_value_new_map();
+      fl_value_set_string_take(args, "id", fl_value_new_int(promiseId));
+      fl_method_channel_invoke_method(owner->channel, kReleasePromisedData, args, nullptr, nullptr, nullptr);
+    }
+    owner = nullptr;
+  }
+
+  cleared = true;
+  if (holds == 0)
+  {
+    delete this;
+  }
+}
+
+// Flattens the HTML of clipboardData into the derived format registered with
+// info on a worker, and calls done once it is stored. Small documents are
+// left for toValue to flatten on the spot.
+static void fl_rich_clipboard_plugin_build_derived(
+    RichClipboardData *clipboardData,
+    guint info,
+    function<void()> done)
+{
+  auto *html = clipboardData->getBuffer(kMimeTextHtml);
+  if (html == nullptr || html->getLength() < kWorkerMinLength)
+  {
+    done();
+    return;
+  }
+
+  // The HTML stays referenced so the worker can read it even if the data
+  // drops it meanwhile.
+  clipboardData->hold();
+  auto *htmlBytes = g_bytes_ref(html->getBytes());
+  auto *htmlData = reinterpret_cast<const gchar *>(html->getData());
+  auto htmlLength = html->getLength();
+  auto text = make_shared<string>();
+  run_on_worker(
+      [htmlData, htmlLength, text]()
+      {
+        *text = html_to_text(htmlData, htmlLength);
+      },
+      [clipboardData, info, htmlBytes, text, done]()
+      {
+        clipboardData->setDerived(clipboardData->getEntry(info), *text);
+        auto *owner = clipboardData->owner;
+        if (owner != nullptr)
+        {
+          fl_rich_clipboard_plugin_record_owned_bytes(owner);
+        }
+        g_bytes_unref(htmlBytes);
+        done();
+        clipboardData->release();
+      });
+}
+
+// Builds the derived or encoded format registered with info on a worker, and
+// calls done once it is stored.
+static void fl_rich_clipboard_plugin_build_format(
+    RichClipboardData *clipboardData,
+    guint info,
+    function<void()> done)
+{
+  if (clipboardData->getEntry(info)->encoded)
+  {
+    fl_rich_clipboard_plugin_encode_image(clipboardData, info, done);
+  }
+  else
+  {
+    fl_rich_clipboard_plugin_build_derived(clipboardData, info, done);
+  }
+}
+
+// Renders any of the requested formats of the data we own that Dart promised
+// but has not provided yet, and builds the derived and encoded ones, then
+// calls done with the data held.
+static void fl_rich_clipboard_plugin_with_owned_data(
+    FlRichClipboardPlugin *self,
+    const vector<string> &mimeTypes,
+    function<void(RichClipboardData *)> done)
+{
+  auto *clipboardData = self->ownedData;
+  clipboardData->hold();
+  auto promised = clipboardData->getPromisedInfos(mimeTypes);
+  auto unbuilt = clipboardData->getUnbuiltInfos(mimeTypes);
+
+  // One extra step keeps renders that finish right away from calling done
+  // before the rest have started.
+  auto remaining = make_shared<gsize>(promised.size() + unbuilt.size() + 1);
+  auto finishStep = [clipboardData, remaining, done]()
+  {
+    if (--*remaining > 0)
+    {
+      return;
+    }
+    done(clipboardData);
+    clipboardData->release();
+  };
+  for (auto info : promised)
+  {
+    fl_rich_clipboard_plugin_render_promise(self, clipboardData, info, finishStep);
+  }
+  for (auto info : unbuilt)
+  {
+    fl_rich_clipboard_plugin_build_format(clipboardData, info, finishStep);
+  }
+  finishStep();
+}
+
+// Answers getData or getBinaryData from the data we own.
+static void fl_rich_clipboard_plugin_respond_owned_data(
+    FlRichClipboardPlugin *self,
+    FlMethodCall *method_call,
+    const vector<string> &mimeTypes,
+    bool binary)
+{
+  g_object_ref(method_call);
+  fl_rich_clipboard_plugin_with_owned_data(
+      self, mimeTypes,
+      [method_call, mimeTypes, binary](RichClipboardData *clipboardData)
+      {
+        g_autoptr(FlValue) result = clipboardData->toValue(mimeTypes, binary);
+        fl_method_call_respond_success(method_call, result, nullptr);
+        g_object_unref(method_call);
+      });
+}
+
+// A payload opened with openDataStream.
+struct DataStream
+{
+  FlRichClipboardPlugin *plugin;
+  guint id;
+  GBytes *bytes;
+  guint idleTimeout = 0;
+};
+
+static void data_stream_free(gpointer data)
+{
+  auto *stream = static_cast<DataStream *>(data);
+  g_clear_handle_id(&stream->idleTimeout, g_source_remove);
+  g_bytes_unref(stream->bytes);
+  delete stream;
+}
+
+static gboolean data_stream_idle_cb(gpointer user_data)
+{
+  auto *stream = static_cast<DataStream *>(user_data);
+  stream->idleTimeout = 0;
+  g_hash_table_remove(stream->plugin->streams, GUINT_TO_POINTER(stream->id));
+  return G_SOURCE_REMOVE;
+}
+
+// Restarts the idle timeout of stream, whenever Dart reads from it.
+static void data_stream_touch(DataStream *stream)
+{
+  g_clear_handle_id(&stream->idleTimeout, g_source_remove);
+  stream->idleTimeout = g_timeout_add(kDataStreamIdleTimeoutMs, data_stream_idle_cb, stream);
+}
+
+// Registers bytes as a stream Dart can read in chunks, and returns the id and
+// total length Dart is told up front.
+static FlValue *fl_rich_clipboard_plugin_open_stream(FlRichClipboardPlugin *self, GBytes *bytes)
+{
+  if (g_hash_table_size(self->streams) >= kMaxDataStreams)
+  {
+    // Ids only grow, so the smallest one is the oldest stream.
+    auto oldest = G_MAXUINT;
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, self->streams);
+    while (g_hash_table_iter_next(&iter, &key, nullptr))
+    {
+      oldest = MIN(oldest, GPOINTER_TO_UINT(key));
+    }
+    g_warning("Dropping clipboard data stream %u, since more than %u are open", oldest, kMaxDataStreams);
+    g_hash_table_remove(self->streams, GUINT_TO_POINTER(oldest));
+  }
+
+  auto id = ++self->nextStreamId;
+  auto *stream = new DataStream{self, id, bytes};
+  data_stream_touch(stream);
+  g_hash_table_insert(self->streams, GUINT_TO_POINTER(id), stream);
+
+  auto *result = fl_value_new_map();
+  fl_value_set_string_take(result, "id", fl_value_new_int(id));
+  fl_value_set_string_take(result, "length", fl_value_new_int(g_bytes_get_size(bytes)));
+  return result;
+}
+
+// Opens a stream over a format of the data we own. The stream shares the
+// payload rather than copying it.
+static void fl_rich_clipboard_plugin_open_owned_stream(
+    FlRichClipboardPlugin *self,
+    FlMethodCall *method_call,
+    const string &mimeType)
+{
+  g_object_ref(method_call);
+  g_object_ref(self);
+  fl_rich_clipboard_plugin_with_owned_data(
+      self, {mimeType},
+      [self, method_call, mimeType](RichClipboardData *clipboardData)
+      {
+        g_autoptr(FlValue) result = nullptr;
+        auto *buffer = clipboardData->getBuiltBuffer(mimeType.c_str());
+        if (buffer != nullptr)
+        {
+          result = fl_rich_clipboard_plugin_open_stream(self, g_bytes_ref(buffer->getBytes()));
+        }
+        fl_method_call_respond_success(method_call, result, nullptr);
+        g_object_unref(method_call);
+        g_object_unref(self);
+      });
+}
+
+// An openDataStream call that is reading a format from another application.
+class OpenStreamRequest : public PluginRequest
+{
+private:
+  string mimeType;
+
+public:
+  OpenStreamRequest(FlRichClipboardPlugin *plugin, FlMethodCall *methodCall, const string &mimeType)
+      : PluginRequest(plugin, methodCall),
+        mimeType(mimeType)
+  {
+  }
+  const string &getMimeType()
+  {
+    return mimeType;
+  }
+};
+
+// Transfers a single type from another application's selection, and calls
+// done with its bytes, or with null if the owner does not offer it.
+static void fl_rich_clipboard_plugin_read_type(
+    FlRichClipboardPlugin *self,
+    GdkAtom selection,
+    const string &mimeType,
+    ClipboardBackend::ContentsCallback done)
+{
+  auto *backend = self->backend;
+  auto *atomTable = self->atoms;
+  backend->requestTargets(
+      selection,
+      [backend, atomTable, selection, mimeType, done](const GdkAtom *atoms, gint n_atoms)
+      {
+        auto target = find_target_for_type(atomTable, mimeType, atoms, n_atoms);
+        if (target == GDK_NONE)
+        {
+          done(nullptr, 0, nullptr);
+          return;
+        }
+        backend->requestContents(selection, target, mimeType == kMimeTextPlain, done);
+      });
+}
+
+// Reads the type of request from CLIPBOARD into a stream.
+static void fl_rich_clipboard_plugin_read_stream(FlRichClipboardPlugin *self, OpenStreamRequest *request)
+{
+  fl_rich_clipboard_plugin_read_type(
+      self, GDK_SELECTION_CLIPBOARD, request->getMimeType(),
+      [request](const guchar *data, gsize length, GBytes *bytes)
+      {
+        unique_ptr<OpenStreamRequest> finished(request);
+
+        // Keeping the transfer in native memory lets Dart pull it in chunks
+        // instead of as one FlValue and String. The backend's bytes are kept
+        // when it hands them over.
+        g_autoptr(FlValue) result = nullptr;
+        if (data != nullptr)
+        {
+          auto *plugin = finished->getPlugin();
+          plugin->stats->recordRead(finished->getMimeType(), length);
+          result = fl_rich_clipboard_plugin_open_stream(
+              plugin, bytes != nullptr ? g_bytes_ref(bytes) : g_bytes_new(data, length));
+        }
+        finished->respond(result);
+      });
+}
+
+// A getImage call, which converts the image it finds on a worker.
+class GetImageRequest : public PluginRequest
+{
+private:
+  ImageOptions options;
+
+public:
+  GetImageRequest(FlRichClipboardPlugin *plugin, FlMethodCall *methodCall, const ImageOptions &options)
+      : PluginRequest(plugin, methodCall),
+        options(options)
+  {
+  }
+  // Converts source, an image of sourceType, and answers the call with it.
+  // Images that cannot be decoded are answered with null. The request
+  // deletes itself after responding.
+  void convert(GBytes *source, const string &sourceType)
+  {
+    auto result = make_shared<ConvertedImage>();
+    auto error = make_shared<GError *>(nullptr);
+    auto options = this->options;
+    run_on_worker(
+        [source, sourceType, options, result, error]()
+        {
+          convert_image(source, sourceType, options, *result, error.get());
+        },
+        [this, source, result, error]()
+        {
+          g_autoptr(FlValue) value = nullptr;
+          if (result->bytes != nullptr)
+          {
+            gsize length;
+            auto *data = static_cast<const guint8 *>(g_bytes_get_data(result->bytes, &length));
+            value = fl_value_new_map();
+            fl_value_set_string_take(value, "type", fl_value_new_string(result->mimeType.c_str()));
+            fl_value_set_string_take(value, "width", fl_value_new_int(result->width));
+            fl_value_set_string_take(value, "height", fl_value_new_int(result->height));
+            fl_value_set_string_take(value, "data", fl_value_new_uint8_list(data, length));
+            g_bytes_unref(result->bytes);
+          }
+          else if (*error != nullptr)
+          {
+            g_warning("Failed to convert clipboard image: %s", (*error)->message);
+            g_error_free(*error);
+          }
+          g_bytes_unref(source);
+          respond(value);
+          delete this;
+        });
+  }
+};
+
+// Finds the first image type the clipboard offers that GdkPixbuf can decode,
+// and converts it for request.
+static void fl_rich_clipboard_plugin_get_image(FlRichClipboardPlugin *self, GetImageRequest *request)
+{
+  auto readable = get_readable_image_types();
+  if (self->ownedData != nullptr)
+  {
+    // Our own image is converted from the bytes Dart gave, not from one of
+    // the encodings that are only produced for pastes.
+    auto *image = self->ownedData->getImage();
+    if (image != nullptr)
+    {
+      request->convert(g_bytes_ref(image->getBytes()), self->ownedData->getImageType());
+      return;
+    }
+    for (auto &mimeType : readable)
+    {
+      auto *buffer = self->ownedData->getBuffer(mimeType.c_str());
+      if (buffer != nullptr)
+      {
+        request->convert(g_bytes_ref(buffer->getBytes()), mimeType);
+        return;
+      }
+    }
+    request->respond(nullptr);
+    delete request;
+    return;
+  }
+
+  auto *backend = self->backend;
+  auto *atomTable = self->atoms;
+  backend->requestTargets(
+      GDK_SELECTION_CLIPBOARD,
+      [backend, atomTable, request, readable](const GdkAtom *atoms, gint n_atoms)
+      {
+        for (auto &mimeType : readable)
+        {
+          auto target = atomTable->intern(mimeType);
+          if (find(atoms, atoms + n_atoms, target) == atoms + n_atoms)
+          {
+            continue;
+          }
+          backend->requestContents(
+              GDK_SELECTION_CLIPBOARD,
+              target,
+              false,
+              [request, mimeType](const guchar *data, gsize length, GBytes *bytes)
+              {
+                if (data == nullptr)
+                {
+                  request->respond(nullptr);
+                  delete request;
+                  return;
+                }
+                request->getPlugin()->stats->recordRead(mimeType, length);
+                request->convert(bytes != nullptr ? g_bytes_ref(bytes) : g_bytes_new(data, length), mimeType);
+              });
+          return;
+        }
+        request->respond(nullptr);
+        delete request;
+      });
+}
+
+static void fl_rich_clipboard_plugin_finish_store(FlRichClipboardPlugin *self, StoreState state)
+{
+  self->storeState = state;
+
+  g_autoptr(FlValue) result = fl_value_new_bool(state == kStoreDone);
+  for (guint i = 0; i < self->storeCalls->len; i++)
+  {
+    auto *method_call = FL_METHOD_CALL(g_ptr_array_index(self->storeCalls, i));
+    fl_method_call_respond_success(method_call, result, nullptr);
+  }
+  g_ptr_array_set_size(self->storeCalls, 0);
+}
+
+// Asks the clipboard manager to copy the data we own, so it outlives us.
+static void fl_rich_clipboard_plugin_start_store(FlRichClipboardPlugin *self)
+{
+  // A handoff of data we no longer own is moot.
+  if (self->storeState == kStoreRunning)
+  {
+    fl_rich_clipboard_plugin_finish_store(self, kStoreFailed);
+  }
+
+  auto *clipboardData = self->ownedData;
+  if (clipboardData == nullptr || clipboardData->promiseId != 0)
+  {
+    fl_rich_clipboard_plugin_finish_store(self, kStoreFailed);
+    return;
+  }
+
+  // Images are not encoded just for the manager, which gets them as Dart
+  // gave them.
+  vector<GdkAtom> targets;
+  for (auto target : clipboardData->getTargets())
+  {
+    if (!clipboardData->isEncoded(self->atoms->getName(target).c_str()))
+    {
+      targets.push_back(target);
+    }
+  }
+
+  // The outcome of a handoff that was replaced or abandoned meanwhile is
+  // ignored.
+  auto serial = ++self->storeSerial;
+  self->storeState = kStoreRunning;
+  self->backend->store(
+      targets,
+      [self, serial](StoreOutcome outcome)
+      {
+        if (self->storeSerial == serial && self->storeState == kStoreRunning)
+        {
+          self->stats->recordStore(outcome);
+          fl_rich_clipboard_plugin_finish_store(self, outcome == kStoreOutcomeStored ? kStoreDone : kStoreFailed);
+        }
+      });
+}
+
+// Takes ownership of selection with clipboardData. Setting the new data
+// replaces whatever was there, and releases data we set before through its
+// clear callback.
+static void fl_rich_clipboard_plugin_offer_data(
+    FlRichClipboardPlugin *self,
+    GdkAtom selection,
+    RichClipboardData *clipboardData,
+    bool canStore)
+{
+  auto *targetList = gtk_target_list_new(nullptr, 0);
+  clipboardData->addTargets(targetList);
+  gint numTargets;
+  auto *targetTable = gtk_target_table_new_from_list(targetList, &numTargets);
+  gtk_target_list_unref(targetList);
+  self->backend->setData(selection, targetTable, numTargets, clipboardData);
+  clipboardData->setTypes(self->atoms, targetTable, numTargets);
+  clipboardData->owner = self;
+  if (canStore)
+  {
+    // Lets the data be handed over when the application exits.
+    vector<GtkTargetEntry> storable;
+    for (gint i = 0; i < numTargets; i++)
+    {
+      if (!clipboardData->isEncoded(targetTable[i].target))
+      {
+        storable.push_back(targetTable[i]);
+      }
+    }
+    self->backend->setCanStore(storable.data(), storable.size());
+  }
+  gtk_target_table_free(targetTable, numTargets);
+}
+
+// Takes ownership of the clipboard with clipboardData, or just clears the
+// clipboard if it is empty. Promised formats are never handed to the
+// clipboard manager, since storing them would render every one of them.
+static void fl_rich_clipboard_plugin_set_clipboard_data(
+    FlRichClipboardPlugin *self,
+    RichClipboardData *clipboardData)
+{
+  // Copying what we own already would only make other applications drop
+  // what they read from us, and hand the same data to the clipboard manager
+  // again.
+  if (self->ownedData != nullptr && clipboardData->promiseId == 0 && self->ownedData->promiseId == 0 &&
+      clipboardData->hasSameContent(self->ownedData))
+  {
+    self->stats->recordDeduplicatedWrite();
+    delete clipboardData;
+    return;
+  }
+
+  fl_rich_clipboard_plugin_invalidate_snapshot(self);
+
+  if (clipboardData->isEmpty())
+  {
+    self->backend->empty(GDK_SELECTION_CLIPBOARD);
+    fl_rich_clipboard_plugin_finish_store(self, kStoreIdle);
+    delete clipboardData;
+    return;
+  }
+
+  // Text that was selected before it was copied is already held for PRIMARY.
+  if (self->primaryData != nullptr)
+  {
+    clipboardData->shareBuffersWith(self->primaryData);
+  }
+  fl_rich_clipboard_plugin_offer_data(self, GDK_SELECTION_CLIPBOARD, clipboardData, clipboardData->promiseId == 0);
+  self->ownedData = clipboardData;
+  fl_rich_clipboard_plugin_record_owned_bytes(self);
+
+  fl_rich_clipboard_plugin_start_store(self);
+}
+
+// Installs the pending write, and answers every set call it replaced in the
+// order they arrived.
+static void fl_rich_clipboard_plugin_flush_writes(FlRichClipboardPlugin *self)
+{
+  g_clear_handle_id(&self->flushSource, g_source_remove);
+  auto *clipboardData = self->pendingData;
+  if (clipboardData == nullptr)
+  {
+    return;
+  }
+  self->pendingData = nullptr;
+  fl_rich_clipboard_plugin_set_clipboard_data(self, clipboardData);
+
+  for (guint i = 0; i < self->pendingCalls->len; i++)
+  {
+    auto *method_call = FL_METHOD_CALL(g_ptr_array_index(self->pendingCalls, i));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  }
+  g_ptr_array_set_size(self->pendingCalls, 0);
+}
+
+static gboolean flush_writes_cb(gpointer user_data)
+{
+  auto *self = FL_MY_PLUGIN_PLUGIN(user_data);
+  self->flushSource = 0;
+  fl_rich_clipboard_plugin_flush_writes(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Queues clipboardData to be installed once the calls that are already
+// waiting have been handled. Writes that arrive back to back replace each
+// other, so only the last one claims ownership and is handed to the
+// clipboard manager. Every call is still answered, in order, once that has
+// happened.
+static void fl_rich_clipboard_plugin_queue_write(
+    FlRichClipboardPlugin *self,
+    FlMethodCall *method_call,
+    RichClipboardData *clipboardData)
+{
+  fl_rich_clipboard_plugin_record_writes(self, clipboardData);
+  delete self->pendingData;
+  self->pendingData = clipboardData;
+  g_ptr_array_add(self->pendingCalls, g_object_ref(method_call));
+  if (self->flushSource == 0)
+  {
+    self->flushSource = g_idle_add(flush_writes_cb, self);
+  }
+}
+
+// Publishes the latest selection Dart set for PRIMARY, if it differs from the
+// one we already own.
+static void fl_rich_clipboard_plugin_publish_primary(FlRichClipboardPlugin *self)
+{
+  auto *clipboardData = self->pendingPrimary;
+  self->pendingPrimary = nullptr;
+  if (clipboardData == nullptr)
+  {
+    return;
+  }
+
+  if (clipboardData->isEmpty())
+  {
+    // Nothing is selected anymore. Only give up the selection if it is ours.
+    if (self->primaryData != nullptr)
+    {
+      self->backend->clear(GDK_SELECTION_PRIMARY);
+    }
+    delete clipboardData;
+    return;
+  }
+  if (self->primaryData != nullptr && clipboardData->hasSameContent(self->primaryData))
+  {
+    delete clipboardData;
+    return;
+  }
+
+  if (self->ownedData != nullptr)
+  {
+    clipboardData->shareBuffersWith(self->ownedData);
+  }
+  fl_rich_clipboard_plugin_offer_data(self, GDK_SELECTION_PRIMARY, clipboardData, false);
+  self->primaryData = clipboardData;
+  fl_rich_clipboard_plugin_record_owned_bytes(self);
+}
+
+static gboolean primary_timeout_cb(gpointer user_data)
+{
+  auto *self = FL_MY_PLUGIN_PLUGIN(user_data);
+  if (self->pendingPrimary == nullptr)
+  {
+    self->primaryTimeout = 0;
+    return G_SOURCE_REMOVE;
+  }
+  fl_rich_clipboard_plugin_publish_primary(self);
+  return G_SOURCE_CONTINUE;
+}
+
+// Sets the PRIMARY selection. The first selection after a quiet period is
+// published right away. Until kPrimaryIntervalMs have passed, later ones
+// only replace the pending selection, so a selection drag claims ownership
+// and hands out the selected text at most once per interval.
+static void fl_rich_clipboard_plugin_set_primary_data(
+    FlRichClipboardPlugin *self,
+    RichClipboardData *clipboardData)
+{
+  fl_rich_clipboard_plugin_record_writes(self, clipboardData);
+  delete self->pendingPrimary;
+  self->pendingPrimary = clipboardData;
+  if (self->primaryTimeout == 0)
+  {
+    fl_rich_clipboard_plugin_publish_primary(self);
+    self->primaryTimeout = g_timeout_add(kPrimaryIntervalMs, primary_timeout_cb, self);
+  }
+}
+
+static void fl_rich_clipboard_plugin_send_change(FlRichClipboardPlugin *self, FlValue *types)
+{
+  g_autoptr(FlValue) event = fl_value_new_map();
+  fl_value_set_string_take(event, "sequence", fl_value_new_int(++self->changeSequence));
+  fl_value_set_string_take(event, "timestamp", fl_value_new_int(g_get_real_time() / 1000));
+  fl_value_set_string(event, "types", types);
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_event_channel_send(self->changesChannel, event, nullptr, &error))
+    g_warning("Failed to send clipboard change event: %s", error->message);
+}
+
+static void fl_rich_clipboard_plugin_request_change_targets(FlRichClipboardPlugin *self);
+
+static void fl_rich_clipboard_plugin_change_targets_received(
+    FlRichClipboardPlugin *self,
+    const GdkAtom *atoms,
+    gint n_atoms)
+{
+  self->changeTargetsPending = FALSE;
+
+  if (self->changeTargetsStale)
+  {
+    fl_rich_clipboard_plugin_request_change_targets(self);
+    return;
+  }
+
+  g_autoptr(FlValue) types = self->atoms->newTypesValue(atoms, n_atoms);
+  // The targets are the same ones getAvailableTypes would fetch next.
+  if (self->canCacheSnapshot && self->generation == self->changeGeneration)
+  {
+    fl_rich_clipboard_plugin_cache_targets(self, types, atoms, n_atoms);
+  }
+  if (self->listening)
+  {
+    fl_rich_clipboard_plugin_send_change(self, types);
+  }
+}
+
+static void fl_rich_clipboard_plugin_request_change_targets(FlRichClipboardPlugin *self)
+{
+  if (self->changeTargetsPending)
+  {
+    self->changeTargetsStale = TRUE;
+    return;
+  }
+  self->changeTargetsPending = TRUE;
+  self->changeTargetsStale = FALSE;
+  self->changeGeneration = self->generation;
+  g_object_ref(self);
+  self->backend->requestTargets(
+      GDK_SELECTION_CLIPBOARD,
+      [self](const GdkAtom *atoms, gint n_atoms)
+      {
+        fl_rich_clipboard_plugin_change_targets_received(self, atoms, n_atoms);
+        g_object_unref(self);
+      });
+}
+
+// Returns the bytes of a decoded transfer without copying them.
+static void get_value_bytes(FlValue *value, const guchar **data, gsize *length)
+{
+  if (fl_value_get_type(value) == FL_VALUE_TYPE_UINT8_LIST)
+  {
+    *data = fl_value_get_uint8_list(value);
+    *length = fl_value_get_length(value);
+  }
+  else
+  {
+    *data = reinterpret_cast<const guchar *>(fl_value_get_string(value));
+    *length = strlen(fl_value_get_string(value));
+  }
+}
+
+// A capture of CLIPBOARD for the history that is waiting for its transfers.
+// ownedBytes holds each text type of data we own, and jobs each one read
+// from another application, which is decoded along with packing.
+struct HistoryCapture
+{
+  FlRichClipboardPlugin *plugin;
+  guint64 generation;
+  bool owned = false;
+  guint pending = 1;
+  map<string, GBytes *> ownedBytes;
+  map<string, DecodeJob> jobs;
+  unique_ptr<ClipboardHistory::Snapshot> snapshot;
+};
+
+// Decodes and packs a capture on a worker, then adds it to the history.
+// Text read from another application also goes into the snapshot getData
+// answers from, so reading it right after the change costs no transfer.
+static void fl_rich_clipboard_plugin_pack_capture(HistoryCapture *capture)
+{
+  run_on_worker(
+      [capture]()
+      {
+        vector<ClipboardHistory::FormatView> formats;
+        for (auto &job : capture->jobs)
+        {
+          if (job.second.value == nullptr)
+          {
+            job.second.value = new_string_value(
+                job.first, job.second.targetName.c_str(),
+                reinterpret_cast<const guchar *>(job.second.data.data()), job.second.data.size());
+            string().swap(job.second.data);
+          }
+          ClipboardHistory::FormatView format{job.first, nullptr, 0};
+          get_value_bytes(job.second.value, &format.data, &format.length);
+          formats.push_back(format);
+        }
+        for (auto &owned : capture->ownedBytes)
+        {
+          ClipboardHistory::FormatView format{owned.first, nullptr, 0};
+          format.data = static_cast<const guchar *>(g_bytes_get_data(owned.second, &format.length));
+          formats.push_back(format);
+        }
+        capture->snapshot = ClipboardHistory::pack(formats);
+      },
+      [capture]()
+      {
+        unique_ptr<HistoryCapture> finished(capture);
+        auto *self = capture->plugin;
+        if (self->history != nullptr)
+        {
+          self->history->add(move(capture->snapshot));
+        }
+        if (!capture->owned && self->canCacheSnapshot && self->generation == capture->generation)
+        {
+          if (self->cachedData == nullptr)
+          {
+            self->cachedData = fl_value_new_map();
+          }
+          for (auto &mimeType : kStringTypes)
+          {
+            auto job = capture->jobs.find(mimeType);
+            fl_value_set_string_take(
+                self->cachedData,
+                mimeType.c_str(),
+                job != capture->jobs.end() ? fl_value_ref(job->second.value) : fl_value_new_null());
+          }
+        }
+        for (auto &job : capture->jobs)
+        {
+          fl_value_unref(job.second.value);
+        }
+        for (auto &owned : capture->ownedBytes)
+        {
+          g_bytes_unref(owned.second);
+        }
+        g_object_unref(self);
+      });
+}
+
+// Marks one step of a capture as finished, and packs it after the last one.
+static void fl_rich_clipboard_plugin_finish_capture(HistoryCapture *capture)
+{
+  if (--capture->pending > 0)
+  {
+    return;
+  }
+  if (capture->jobs.empty() && capture->ownedBytes.empty())
+  {
+    // Nothing the history keeps, like an image.
+    g_object_unref(capture->plugin);
+    delete capture;
+    return;
+  }
+  fl_rich_clipboard_plugin_pack_capture(capture);
+}
+
+// Captures the text types of CLIPBOARD for the history. Data we own is taken
+// from memory, and another application's data is read once for the history
+// and getData alike.
+static void fl_rich_clipboard_plugin_capture_history(FlRichClipboardPlugin *self)
+{
+  auto *capture = new HistoryCapture();
+  capture->plugin = FL_MY_PLUGIN_PLUGIN(g_object_ref(self));
+  capture->generation = self->generation;
+
+  if (self->ownedData != nullptr)
+  {
+    capture->owned = true;
+    for (auto &mimeType : kStringTypes)
+    {
+      auto *buffer = self->ownedData->getBuffer(mimeType.c_str());
+      if (buffer != nullptr)
+      {
+        capture->ownedBytes[mimeType] = g_bytes_ref(buffer->getBytes());
+      }
+    }
+    fl_rich_clipboard_plugin_finish_capture(capture);
+    return;
+  }
+
+  auto *backend = self->backend;
+  auto *atomTable = self->atoms;
+  backend->requestTargets(
+      GDK_SELECTION_CLIPBOARD,
+      [backend, atomTable, capture](const GdkAtom *atoms, gint n_atoms)
+      {
+        for (auto &mimeType : kStringTypes)
+        {
+          auto target = find_target_for_type(atomTable, mimeType, atoms, n_atoms);
+          if (target == GDK_NONE)
+          {
+            continue;
+          }
+          capture->pending++;
+          backend->requestContents(
+              GDK_SELECTION_CLIPBOARD,
+              target,
+              mimeType == kMimeTextPlain,
+              [capture, mimeType, target](const guchar *data, gsize length, GBytes *bytes)
+              {
+                if (data != nullptr)
+                {
+                  capture->plugin->stats->recordRead(mimeType, length);
+                  auto &job = capture->jobs[mimeType];
+                  job.targetName = capture->plugin->atoms->getName(target);
+                  job.data.assign(reinterpret_cast<const gchar *>(data), length);
+                }
+                fl_rich_clipboard_plugin_finish_capture(capture);
+              });
+        }
+        fl_rich_clipboard_plugin_finish_capture(capture);
+      });
+}
+
+// Answers getHistoryEntry. Large entries are unpacked on a worker.
+static void fl_rich_clipboard_plugin_respond_history_entry(
+    FlRichClipboardPlugin *self,
+    FlMethodCall *method_call,
+    guint64 id)
+{
+  auto snapshot = self->history != nullptr ? self->history->find(id) : nullptr;
+  if (snapshot == nullptr || g_bytes_get_size(snapshot->block) < kWorkerMinLength)
+  {
+    g_autoptr(FlValue) result = snapshot != nullptr ? ClipboardHistory::unpack(*snapshot) : nullptr;
+    fl_method_call_respond_success(method_call, result, nullptr);
+    return;
+  }
+
+  g_object_ref(method_call);
+  auto result = make_shared<FlValue *>(nullptr);
+  run_on_worker(
+      [snapshot, result]()
+      {
+        *result = ClipboardHistory::unpack(*snapshot);
+      },
+      [method_call, result]()
+      {
+        fl_method_call_respond_success(method_call, *result, nullptr);
+        fl_value_unref(*result);
+        g_object_unref(method_call);
+      });
+}
+
+static void fl_rich_clipboard_plugin_owner_changed(FlRichClipboardPlugin *self, guint32 selectionTime)
+{
+  fl_rich_clipboard_plugin_invalidate_snapshot(self);
+
+  // Some backends report the same ownership change more than once. Backends
+  // without selection timestamps report 0, which cannot be deduplicated.
+  if (selectionTime != 0 && selectionTime == self->lastChangeSelectionTime)
+  {
+    return;
+  }
+  self->lastChangeSelectionTime = selectionTime;
+
+  if (self->history != nullptr)
+  {
+    fl_rich_clipboard_plugin_capture_history(self);
+  }
+  if (!self->listening)
+  {
+    return;
+  }
+
+  if (self->ownedData != nullptr)
+  {
+    fl_rich_clipboard_plugin_send_change(self, self->ownedData->getTypes());
+  }
+  else
+  {
+    fl_rich_clipboard_plugin_request_change_targets(self);
+  }
+}
+
+static FlMethodErrorResponse *changes_listen_cb(FlEventChannel *channel, FlValue *args, gpointer user_data)
+{
+  auto *self = FL_MY_PLUGIN_PLUGIN(user_data);
+  self->listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse *changes_cancel_cb(FlEventChannel *channel, FlValue *args, gpointer user_data)
+{
+  auto *self = FL_MY_PLUGIN_PLUGIN(user_data);
+  self->listening = FALSE;
+  return nullptr;
+}
+
+// The text types getData or getPrimaryData should read. Callers may pass the
+// list of types they want, and only those are transferred. Without it every
+// supported type is read.
+static vector<string> get_string_types(FlValue *args)
+{
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_LIST)
+  {
+    return kStringTypes;
+  }
+
+  vector<string> mimeTypes;
+  for (auto &mimeType : kStringTypes)
+  {
+    for (size_t i = 0; i < fl_value_get_length(args); i++)
+    {
+      auto *type = fl_value_get_list_value(args, i);
+      if (fl_value_get_type(type) == FL_VALUE_TYPE_STRING &&
+          mimeType == fl_value_get_string(type))
+      {
+        mimeTypes.push_back(mimeType);
+        break;
+      }
+    }
+  }
+  return mimeTypes;
+}
+
+// Fingerprints the text and HTML on CLIPBOARD from what is in memory: the
+// data we own, or the snapshot of what was read from another application.
+// Both are hashed the same way, so the same content fingerprints the same
+// whoever owns it and whatever was read first. Returns null if an offered
+// type has not been read yet, since hashing it would take a transfer.
+static FlValue *fl_rich_clipboard_plugin_get_fingerprint(FlRichClipboardPlugin *self)
+{
+  string combined;
+  for (auto &mimeType : kStringTypes)
+  {
+    bool present = false;
+    guint64 hash = 0;
+    if (self->ownedData != nullptr)
+    {
+      if (!self->ownedData->hashText(mimeType.c_str(), present, hash))
+      {
+        return fl_value_new_null();
+      }
+    }
+    else
+    {
+      auto *value = self->cachedData != nullptr ? fl_value_lookup_string(self->cachedData, mimeType.c_str()) : nullptr;
+      if (value != nullptr)
+      {
+        // The snapshot holds null for types the owner did not provide.
+        present = fl_value_get_type(value) == FL_VALUE_TYPE_STRING;
+        if (present)
+        {
+          auto *text = fl_value_get_string(value);
+          hash = content_hash(text, strlen(text));
+        }
+      }
+      else if (self->cachedTargets == nullptr ||
+               find_target_for_type(self->atoms, mimeType, self->cachedTargets->data(),
+                                    self->cachedTargets->size()) != GDK_NONE)
+      {
+        return fl_value_new_null();
+      }
+    }
+
+    combined.append(mimeType.c_str(), mimeType.size() + 1);
+    combined.push_back(present ? 1 : 0);
+    combined.append(reinterpret_cast<const gchar *>(&hash), sizeof(hash));
+  }
+  g_autofree gchar *fingerprint =
+      g_strdup_printf("%016" G_GINT64_MODIFIER "x", content_hash(combined.data(), combined.size()));
+  return fl_value_new_string(fingerprint);
+}
+
+// Answers getContentFingerprint. Plain text derived from large HTML we own is
+// flattened on a worker first, so hashing it does not block the main loop.
+static void fl_rich_clipboard_plugin_respond_fingerprint(FlRichClipboardPlugin *self, FlMethodCall *method_call)
+{
+  auto *clipboardData = self->ownedData;
+  auto unbuilt = clipboardData != nullptr ? clipboardData->getUnbuiltInfos(kStringTypes) : vector<guint>();
+  if (unbuilt.empty())
+  {
+    g_autoptr(FlValue) result = fl_rich_clipboard_plugin_get_fingerprint(self);
+    fl_method_call_respond_success(method_call, result, nullptr);
+    return;
+  }
+
+  g_object_ref(self);
+  g_object_ref(method_call);
+  clipboardData->hold();
+  // One extra step keeps builds that finish right away from responding
+  // before the rest have started.
+  auto remaining = make_shared<gsize>(unbuilt.size() + 1);
+  auto finishStep = [self, method_call, clipboardData, remaining]()
+  {
+    if (--*remaining > 0)
+    {
+      return;
+    }
+    // Ownership may have changed meanwhile, so this hashes whatever is on
+    // CLIPBOARD now.
+    g_autoptr(FlValue) result = fl_rich_clipboard_plugin_get_fingerprint(self);
+    fl_method_call_respond_success(method_call, result, nullptr);
+    g_object_unref(method_call);
+    clipboardData->release();
+    g_object_unref(self);
+  };
+  for (auto info : unbuilt)
+  {
+    fl_rich_clipboard_plugin_build_derived(clipboardData, info, finishStep);
+  }
+  finishStep();
+}
+
+// Builds the data for setData or setPrimaryData from its map of text types to
+// strings. With derivePlainText set and no plain text given, plain text is
+// flattened from the HTML once something asks for it.
+static RichClipboardData *new_string_data(FlValue *args)
+{
+  auto *clipboardData = new RichClipboardData();
+  for (auto &mimeType : kStringTypes)
+  {
+    auto *value = fl_value_lookup_string(args, mimeType.c_str());
+    if (value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_STRING)
+    {
+      clipboardData->set(mimeType.c_str(), value);
+    }
+  }
+  auto *derive = fl_value_lookup_string(args, kDerivePlainText);
+  if (derive != nullptr && fl_value_get_type(derive) == FL_VALUE_TYPE_BOOL && fl_value_get_bool(derive) &&
+      clipboardData->getBuffer(kMimeTextPlain) == nullptr && clipboardData->getBuffer(kMimeTextHtml) != nullptr)
+  {
+    clipboardData->derivePlainText();
+  }
+  return clipboardData;
+}
+
+// Builds the data for setFileData from its map of types to file paths. Each
+// file is mapped rather than read, so its bytes are only paged in when a
+// paste asks for them. Returns null if a file cannot be mapped.
+static RichClipboardData *fl_rich_clipboard_plugin_new_file_data(FlValue *args, GError **error)
+{
+  unique_ptr<RichClipboardData> clipboardData(new RichClipboardData());
+  for (size_t i = 0; i < fl_value_get_length(args); i++)
+  {
+    auto *key = fl_value_get_map_key(args, i);
+    auto *value = fl_value_get_map_value(args, i);
+    if (fl_value_get_type(key) != FL_VALUE_TYPE_STRING || fl_value_get_type(value) != FL_VALUE_TYPE_STRING)
+    {
+      continue;
+    }
+
+    auto *file = g_mapped_file_new(fl_value_get_string(value), FALSE, error);
+    if (file == nullptr)
+    {
+      return nullptr;
+    }
+    // An empty file maps to no memory at all, which would read as missing
+    // data rather than as an empty payload.
+    g_autoptr(GBytes) bytes = g_mapped_file_get_length(file) > 0 ? g_mapped_file_get_bytes(file)
+                                                                  : g_bytes_new_static("", 0);
+    g_mapped_file_unref(file);
+    clipboardData->set(fl_value_get_string(key), bytes);
+  }
+  return clipboardData.release();
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel *channel, FlMethodCall *method_call,
+                           gpointer user_data)
+{
+  auto *self = FL_MY_PLUGIN_PLUGIN(user_data);
+  const gchar *method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kGetStats) != 0 && strcmp(method, kResetStats) != 0)
+  {
+    fl_rich_clipboard_plugin_time_call(self, method_call);
+  }
+  // Everything but another write has to see the last write first.
+  if (strcmp(method, kSetData) != 0 && strcmp(method, kSetBinaryData) != 0 &&
+      strcmp(method, kSetFileData) != 0 && strcmp(method, kSetImage) != 0 &&
+      strcmp(method, kSetPromisedData) != 0)
+  {
+    fl_rich_clipboard_plugin_flush_writes(self);
+  }
+
+  if (strcmp(method, kGetAvailableTypes) == 0)
+  {
+    if (self->ownedData != nullptr)
+    {
+      fl_method_call_respond_success(method_call, self->ownedData->getTypes(), nullptr);
+    }
+    else if (self->cachedTypes != nullptr)
+    {
+      fl_method_call_respond_success(method_call, self->cachedTypes, nullptr);
+    }
+    else
+    {
+      auto *request = new PluginRequest(self, method_call);
+      self->backend->requestTargets(
+          GDK_SELECTION_CLIPBOARD,
+          [request](const GdkAtom *atoms, gint n_atoms)
+          {
+            fl_rich_clipboard_plugin_types_received(request, atoms, n_atoms);
+            delete request;
+          });
+    }
+  }
+  else if (strcmp(method, kGetData) == 0)
+  {
+    auto mimeTypes = get_string_types(fl_method_call_get_args(method_call));
+    if (self->ownedData != nullptr)
+    {
+      fl_rich_clipboard_plugin_respond_owned_data(self, method_call, mimeTypes, false);
+      return;
+    }
+
+    // Answer what the snapshot already has and only transfer the rest.
+    g_autoptr(FlValue) known = fl_value_new_map();
+    vector<string> missing;
+    for (auto &mimeType : mimeTypes)
+    {
+      auto *value = self->cachedData != nullptr
+                        ? fl_value_lookup_string(self->cachedData, mimeType.c_str())
+                        : nullptr;
+      if (value == nullptr)
+      {
+        missing.push_back(mimeType);
+      }
+      else if (fl_value_get_type(value) != FL_VALUE_TYPE_NULL)
+      {
+        fl_value_set_string(known, mimeType.c_str(), value);
+      }
+    }
+
+    if (missing.empty())
+    {
+      fl_method_call_respond_success(method_call, known, nullptr);
+    }
+    else
+    {
+      fl_rich_clipboard_plugin_read_data(
+          self, GDK_SELECTION_CLIPBOARD, new GetDataRequest(self, method_call, missing, false, known));
+    }
+  }
+  else if (strcmp(method, kGetBinaryData) == 0)
+  {
+    auto *args = fl_method_call_get_args(method_call);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_LIST)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected a list of types", nullptr, nullptr);
+      return;
+    }
+    vector<string> mimeTypes;
+    for (size_t i = 0; i < fl_value_get_length(args); i++)
+    {
+      auto *typeValue = fl_value_get_list_value(args, i);
+      if (fl_value_get_type(typeValue) == FL_VALUE_TYPE_STRING)
+      {
+        mimeTypes.push_back(fl_value_get_string(typeValue));
+      }
+    }
+
+    if (self->ownedData != nullptr)
+    {
+      fl_rich_clipboard_plugin_respond_owned_data(self, method_call, mimeTypes, true);
+    }
+    else
+    {
+      fl_rich_clipboard_plugin_read_data(
+          self, GDK_SELECTION_CLIPBOARD, new GetDataRequest(self, method_call, mimeTypes, true));
+    }
   }
-  void setTextPlain(const gchar *text)
+  else if (strcmp(method, kOpenDataStream) == 0)
   {
-    textPlain.reset(new string(text));
+    auto *args = fl_method_call_get_args(method_call);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_STRING)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected a type", nullptr, nullptr);
+      return;
+    }
+    string mimeType = fl_value_get_string(args);
+
+    if (self->ownedData != nullptr)
+    {
+      fl_rich_clipboard_plugin_open_owned_stream(self, method_call, mimeType);
+    }
+    else
+    {
+      fl_rich_clipboard_plugin_read_stream(self, new OpenStreamRequest(self, method_call, mimeType));
+    }
   }
-  string *getTextHtml()
+  else if (strcmp(method, kReadDataStream) == 0)
   {
-    return textHtml.get();
+    auto *args = fl_method_call_get_args(method_call);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected an id, offset and length", nullptr, nullptr);
+      return;
+    }
+    auto *idValue = fl_value_lookup_string(args, "id");
+    auto *offsetValue = fl_value_lookup_string(args, "offset");
+    auto *lengthValue = fl_value_lookup_string(args, "length");
+    if (idValue == nullptr || fl_value_get_type(idValue) != FL_VALUE_TYPE_INT ||
+        offsetValue == nullptr || fl_value_get_type(offsetValue) != FL_VALUE_TYPE_INT ||
+        lengthValue == nullptr || fl_value_get_type(lengthValue) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(offsetValue) < 0 || fl_value_get_int(lengthValue) < 0)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected an id, offset and length", nullptr, nullptr);
+      return;
+    }
+    auto *stream = static_cast<DataStream *>(
+        g_hash_table_lookup(self->streams, GUINT_TO_POINTER(fl_value_get_int(idValue))));
+    if (stream == nullptr)
+    {
+      fl_method_call_respond_error(method_call, "unknown_stream", "The stream is not open", nullptr, nullptr);
+      return;
+    }
+    data_stream_touch(stream);
+
+    gsize size;
+    auto *data = static_cast<const guint8 *>(g_bytes_get_data(stream->bytes, &size));
+    auto offset = MIN(static_cast<gsize>(fl_value_get_int(offsetValue)), size);
+    auto length = MIN(static_cast<gsize>(fl_value_get_int(lengthValue)), size - offset);
+    g_autoptr(FlValue) result = fl_value_new_uint8_list(data + offset, length);
+    fl_method_call_respond_success(method_call, result, nullptr);
   }
-  void setTextHtml(const gchar *text)
+  else if (strcmp(method, kCloseDataStream) == 0)
   {
-    textHtml.reset(new string(text));
+    auto *args = fl_method_call_get_args(method_call);
+    if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_INT)
+    {
+      g_hash_table_remove(self->streams, GUINT_TO_POINTER(fl_value_get_int(args)));
+    }
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
   }
-  bool isEmpty()
+  else if (strcmp(method, kSetData) == 0)
   {
-    return textPlain == nullptr && textHtml == nullptr;
+    auto *clipboardData = new_string_data(fl_method_call_get_args(method_call));
+    fl_rich_clipboard_plugin_queue_write(self, method_call, clipboardData);
   }
-  bool isNotEmpty()
+  else if (strcmp(method, kGetPrimaryData) == 0)
   {
-    return !isEmpty();
-  }
-};
-
-struct _FlRichClipboardPlugin
-{
-  GObject parent_instance;
-
-  FlPluginRegistrar *registrar;
-
-  // Connection to Flutter engine.
-  FlMethodChannel *channel;
-};
-
-G_DEFINE_TYPE(FlRichClipboardPlugin, fl_rich_clipboard_plugin, g_object_get_type())
-
-static void gtk_clipboard_request_targets_callback(
-    GtkClipboard *clipboard,
-    GdkAtom *atoms,
-    gint n_atoms,
-    gpointer user_data)
-{
-  g_autoptr(FlMethodCall) method_call = static_cast<FlMethodCall *>(user_data);
+    auto mimeTypes = get_string_types(fl_method_call_get_args(method_call));
 
-  g_autoptr(FlValue) result = fl_value_new_list();
-  for (gint i = 0; i < n_atoms; i++)
-  {
-    auto target = gdk_atom_name(atoms[i]);
-    fl_value_append_take(result, fl_value_new_string(target));
-    g_free(target);
+    // A read must see the selection Dart set last, even if it is not
+    // published yet.
+    fl_rich_clipboard_plugin_publish_primary(self);
+    if (self->primaryData != nullptr)
+    {
+      g_autoptr(FlValue) result = self->primaryData->toValue(mimeTypes, false);
+      fl_method_call_respond_success(method_call, result, nullptr);
+    }
+    else
+    {
+      auto *request = new GetDataRequest(self, method_call, mimeTypes, false);
+      request->cacheable = false;
+      fl_rich_clipboard_plugin_read_data(self, GDK_SELECTION_PRIMARY, request);
+    }
   }
-  fl_method_call_respond_success(method_call, result, nullptr);
-}
-
-static void gtk_clipboard_get_target_text_callback(
-    GtkClipboard *clipboard,
-    GtkSelectionData *selectionData,
-    guint info,
-    gpointer user_data_or_owner)
-{
-  auto *clipboardData = reinterpret_cast<RichClipboardData *>(user_data_or_owner);
-  if (info == kUserInfoTextPlain && clipboardData->getTextPlain() != nullptr)
+  else if (strcmp(method, kSetPrimaryData) == 0)
   {
-    auto *textPlainCString = clipboardData->getTextPlain()->c_str();
-    gtk_selection_data_set_text(selectionData, textPlainCString, strlen(textPlainCString));
+    auto *clipboardData = new_string_data(fl_method_call_get_args(method_call));
+    fl_rich_clipboard_plugin_set_primary_data(self, clipboardData);
+
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
   }
-  else if (info == kUserInfoTextHtml && clipboardData->getTextHtml() != nullptr)
+  else if (strcmp(method, kStoreClipboard) == 0)
   {
-    auto *textHtmlCString = clipboardData->getTextHtml()->c_str();
-    gtk_selection_data_set(selectionData, kGdkAtomTextHtml, 8, (guchar *)textHtmlCString, strlen(textHtmlCString));
+    // Join a handoff of the current data that is still running, or report
+    // one that finished. Start a new one if the last one failed.
+    if (self->storeState != kStoreRunning && self->storeState != kStoreDone)
+    {
+      fl_rich_clipboard_plugin_start_store(self);
+    }
+    if (self->storeState == kStoreRunning)
+    {
+      g_ptr_array_add(self->storeCalls, g_object_ref(method_call));
+    }
+    else
+    {
+      g_autoptr(FlValue) result = fl_value_new_bool(self->storeState == kStoreDone);
+      fl_method_call_respond_success(method_call, result, nullptr);
+    }
   }
-}
-
-static void gtk_clipboard_clear_text_callback(GtkClipboard *clipboard, gpointer user_data_or_owner)
-{
-  auto *clipboardData = reinterpret_cast<RichClipboardData *>(user_data_or_owner);
-  delete clipboardData;
-}
-
-// Called when a method call is received from Flutter.
-static void method_call_cb(FlMethodChannel *channel, FlMethodCall *method_call,
-                           gpointer user_data)
-{
-  const gchar *method = fl_method_call_get_name(method_call);
-
-  g_autoptr(FlMethodResponse) response = nullptr;
-  if (strcmp(method, kGetAvailableTypes) == 0)
+  else if (strcmp(method, kSetBinaryData) == 0)
   {
-    auto *clipboard = gtk_clipboard_get_default(gdk_display_get_default());
-    gtk_clipboard_request_targets(
-        clipboard,
-        gtk_clipboard_request_targets_callback,
-        g_object_ref(method_call));
+    auto *args = fl_method_call_get_args(method_call);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected a map of types to data", nullptr, nullptr);
+      return;
+    }
+
+    auto *clipboardData = new RichClipboardData();
+    for (size_t i = 0; i < fl_value_get_length(args); i++)
+    {
+      auto *key = fl_value_get_map_key(args, i);
+      auto *value = fl_value_get_map_value(args, i);
+      if (fl_value_get_type(key) == FL_VALUE_TYPE_STRING && OwnedBuffer::canHold(value))
+      {
+        clipboardData->set(fl_value_get_string(key), value);
+      }
+    }
+    fl_rich_clipboard_plugin_queue_write(self, method_call, clipboardData);
   }
-  else if (strcmp(method, kGetData) == 0)
+  else if (strcmp(method, kSetFileData) == 0)
   {
-    auto *clipboard = gtk_clipboard_get_default(gdk_display_get_default());
-    g_autoptr(FlValue) result = fl_value_new_map();
-
-    auto *text = gtk_clipboard_wait_for_text(clipboard);
-    if (text != nullptr)
+    auto *args = fl_method_call_get_args(method_call);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP)
     {
-      fl_value_set_string_take(result, kMimeTextPlain, fl_value_new_string(text));
-      g_free(text);
+      fl_method_call_respond_error(method_call, "bad_args", "Expected a map of types to paths", nullptr, nullptr);
+      return;
     }
 
-    auto *htmlData = gtk_clipboard_wait_for_contents(clipboard, kGdkAtomTextHtml);
-    if (htmlData != nullptr)
+    g_autoptr(GError) error = nullptr;
+    auto *clipboardData = fl_rich_clipboard_plugin_new_file_data(args, &error);
+    if (clipboardData == nullptr)
+    {
+      fl_method_call_respond_error(method_call, "file_error", error->message, nullptr, nullptr);
+      return;
+    }
+    fl_rich_clipboard_plugin_queue_write(self, method_call, clipboardData);
+  }
+  else if (strcmp(method, kHasTypes) == 0)
+  {
+    auto *args = fl_method_call_get_args(method_call);
+    vector<string> mimeTypes;
+    if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_LIST)
     {
-      // Testing shows that GTK will just return plain if no HTML data is available, so make sure we actually
-      // have HTML before adding it to the result map.
-      auto htmlType = gtk_selection_data_get_data_type(htmlData);
-      auto *htmlTypeName = gdk_atom_name(htmlType);
-      if (strcmp(htmlTypeName, kMimeTextHtml) == 0)
+      for (size_t i = 0; i < fl_value_get_length(args); i++)
       {
-        gint htmlLen;
-        auto *html = gtk_selection_data_get_data_with_length(htmlData, &htmlLen);
-        if (html != nullptr)
+        auto *typeValue = fl_value_get_list_value(args, i);
+        if (fl_value_get_type(typeValue) == FL_VALUE_TYPE_STRING)
         {
-          fl_value_set_string_take(result, kMimeTextHtml, fl_value_new_string_sized((gchar *)html, htmlLen));
+          mimeTypes.push_back(fl_value_get_string(typeValue));
         }
       }
-      g_free(htmlTypeName);
-      gtk_selection_data_free(htmlData);
     }
-
-    fl_method_call_respond_success(method_call, result, nullptr);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_LIST ||
+        mimeTypes.size() != fl_value_get_length(args) || mimeTypes.size() > kMaxHasTypes)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected a list of at most 64 types", nullptr, nullptr);
+      return;
+    }
+    fl_rich_clipboard_plugin_has_types(self, method_call, mimeTypes);
   }
-  else if (strcmp(method, kSetData) == 0)
+  else if (strcmp(method, kGetImage) == 0)
+  {
+    auto *args = fl_method_call_get_args(method_call);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected a map of options", nullptr, nullptr);
+      return;
+    }
+    ImageOptions options;
+    auto *maxWidth = fl_value_lookup_string(args, "maxWidth");
+    auto *maxHeight = fl_value_lookup_string(args, "maxHeight");
+    auto *type = fl_value_lookup_string(args, "type");
+    auto *quality = fl_value_lookup_string(args, "quality");
+    if (maxWidth != nullptr && fl_value_get_type(maxWidth) == FL_VALUE_TYPE_INT)
+    {
+      options.maxWidth = MAX(fl_value_get_int(maxWidth), 0);
+    }
+    if (maxHeight != nullptr && fl_value_get_type(maxHeight) == FL_VALUE_TYPE_INT)
+    {
+      options.maxHeight = MAX(fl_value_get_int(maxHeight), 0);
+    }
+    if (quality != nullptr && fl_value_get_type(quality) == FL_VALUE_TYPE_INT)
+    {
+      options.quality = fl_value_get_int(quality);
+    }
+    if (type != nullptr && fl_value_get_type(type) == FL_VALUE_TYPE_STRING)
+    {
+      options.mimeType = fl_value_get_string(type);
+      if (!is_writable_image_type(options.mimeType))
+      {
+        fl_method_call_respond_error(method_call, "bad_args", "Cannot encode the requested type", nullptr, nullptr);
+        return;
+      }
+    }
+    fl_rich_clipboard_plugin_get_image(self, new GetImageRequest(self, method_call, options));
+  }
+  else if (strcmp(method, kSetImage) == 0)
   {
-    auto *clipboard = gtk_clipboard_get_default(gdk_display_get_default());
-    gtk_clipboard_set_text(clipboard, "", 0);
-    gtk_clipboard_clear(clipboard);
-
     auto *args = fl_method_call_get_args(method_call);
+    auto *data = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                     ? fl_value_lookup_string(args, "data")
+                     : nullptr;
+    auto *type = data != nullptr ? fl_value_lookup_string(args, "type") : nullptr;
+    auto *typesValue = data != nullptr ? fl_value_lookup_string(args, "types") : nullptr;
+    if (data == nullptr || fl_value_get_type(data) != FL_VALUE_TYPE_UINT8_LIST ||
+        type == nullptr || fl_value_get_type(type) != FL_VALUE_TYPE_STRING ||
+        typesValue == nullptr || fl_value_get_type(typesValue) != FL_VALUE_TYPE_LIST)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected data, its type and a list of types", nullptr, nullptr);
+      return;
+    }
 
-    auto *targetList = gtk_target_list_new(nullptr, 0);
+    // Types GdkPixbuf cannot encode are left out rather than failing the
+    // paste later.
+    vector<string> encodings;
+    for (size_t i = 0; i < fl_value_get_length(typesValue); i++)
+    {
+      auto *typeValue = fl_value_get_list_value(typesValue, i);
+      if (fl_value_get_type(typeValue) == FL_VALUE_TYPE_STRING &&
+          is_writable_image_type(fl_value_get_string(typeValue)))
+      {
+        encodings.push_back(fl_value_get_string(typeValue));
+      }
+    }
     auto *clipboardData = new RichClipboardData();
-    auto *textPlainValue = fl_value_lookup_string(args, kMimeTextPlain);
-    if (textPlainValue != nullptr && fl_value_get_type(textPlainValue) == FL_VALUE_TYPE_STRING)
+    clipboardData->setImage(fl_value_get_string(type), data, encodings);
+    fl_rich_clipboard_plugin_queue_write(self, method_call, clipboardData);
+  }
+  else if (strcmp(method, kSetPromisedData) == 0)
+  {
+    auto *args = fl_method_call_get_args(method_call);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP)
     {
-      auto *textPlainCString = fl_value_get_string(textPlainValue);
-      clipboardData->setTextPlain(textPlainCString);
-      gtk_target_list_add_text_targets(targetList, kUserInfoTextPlain);
+      fl_method_call_respond_error(method_call, "bad_args", "Expected an id and a list of types", nullptr, nullptr);
+      return;
     }
-    auto *textHtmlValue = fl_value_lookup_string(args, kMimeTextHtml);
-    if (textHtmlValue != nullptr && fl_value_get_type(textHtmlValue) == FL_VALUE_TYPE_STRING)
+    auto *idValue = fl_value_lookup_string(args, "id");
+    auto *typesValue = fl_value_lookup_string(args, "types");
+    if (idValue == nullptr || fl_value_get_type(idValue) != FL_VALUE_TYPE_INT ||
+        typesValue == nullptr || fl_value_get_type(typesValue) != FL_VALUE_TYPE_LIST)
     {
-      auto *textHtmlCString = fl_value_get_string(textHtmlValue);
-      clipboardData->setTextHtml(textHtmlCString);
-      gtk_target_list_add(targetList, kGdkAtomTextHtml, 0, kUserInfoTextHtml);
+      fl_method_call_respond_error(method_call, "bad_args", "Expected an id and a list of types", nullptr, nullptr);
+      return;
     }
 
-    if (clipboardData->isNotEmpty())
+    auto *clipboardData = new RichClipboardData();
+    clipboardData->promiseId = fl_value_get_int(idValue);
+    for (size_t i = 0; i < fl_value_get_length(typesValue); i++)
     {
-      gint numTargets;
-      auto *targetTable = gtk_target_table_new_from_list(targetList, &numTargets);
-      gtk_clipboard_set_with_data(
-          clipboard,
-          targetTable,
-          numTargets,
-          gtk_clipboard_get_target_text_callback,
-          gtk_clipboard_clear_text_callback,
-          clipboardData);
-      gtk_clipboard_set_can_store(clipboard, targetTable, numTargets);
-      gtk_clipboard_store(clipboard);
-
-      gtk_target_table_free(targetTable, numTargets);
+      auto *typeValue = fl_value_get_list_value(typesValue, i);
+      if (fl_value_get_type(typeValue) == FL_VALUE_TYPE_STRING)
+      {
+        clipboardData->promise(fl_value_get_string(typeValue));
+      }
+    }
+    fl_rich_clipboard_plugin_queue_write(self, method_call, clipboardData);
+  }
+  else if (strcmp(method, kGetStats) == 0)
+  {
+    g_autoptr(FlValue) result = self->stats->toValue();
+    fl_method_call_respond_success(method_call, result, nullptr);
+  }
+  else if (strcmp(method, kResetStats) == 0)
+  {
+    self->stats->reset();
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  }
+  else if (strcmp(method, kGetContentFingerprint) == 0)
+  {
+    fl_rich_clipboard_plugin_respond_fingerprint(self, method_call);
+  }
+  else if (strcmp(method, kEnableHistory) == 0)
+  {
+    auto *args = fl_method_call_get_args(method_call);
+    auto *maxBytes = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                         ? fl_value_lookup_string(args, "maxBytes")
+                         : nullptr;
+    if (maxBytes == nullptr || fl_value_get_type(maxBytes) != FL_VALUE_TYPE_INT || fl_value_get_int(maxBytes) <= 0)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected a positive maxBytes", nullptr, nullptr);
+      return;
+    }
+    if (self->history == nullptr)
+    {
+      self->history = new ClipboardHistory(fl_value_get_int(maxBytes));
+    }
+    else
+    {
+      self->history->setMaxBytes(fl_value_get_int(maxBytes));
+    }
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  }
+  else if (strcmp(method, kDisableHistory) == 0)
+  {
+    delete self->history;
+    self->history = nullptr;
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  }
+  else if (strcmp(method, kClearHistory) == 0)
+  {
+    if (self->history != nullptr)
+    {
+      self->history->clear();
     }
-    gtk_target_list_unref(targetList);
-
     fl_method_call_respond_success(method_call, nullptr, nullptr);
   }
+  else if (strcmp(method, kGetHistory) == 0)
+  {
+    auto *args = fl_method_call_get_args(method_call);
+    auto *before = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                       ? fl_value_lookup_string(args, "before")
+                       : nullptr;
+    auto *limit = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                      ? fl_value_lookup_string(args, "limit")
+                      : nullptr;
+    if ((before != nullptr && fl_value_get_type(before) != FL_VALUE_TYPE_INT &&
+         fl_value_get_type(before) != FL_VALUE_TYPE_NULL) ||
+        limit == nullptr || fl_value_get_type(limit) != FL_VALUE_TYPE_INT || fl_value_get_int(limit) < 0)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected a limit", nullptr, nullptr);
+      return;
+    }
+    guint64 beforeId = before != nullptr && fl_value_get_type(before) == FL_VALUE_TYPE_INT ? fl_value_get_int(before) : 0;
+    g_autoptr(FlValue) result = self->history != nullptr
+                                    ? self->history->listValue(beforeId, fl_value_get_int(limit))
+                                    : fl_value_new_list();
+    fl_method_call_respond_success(method_call, result, nullptr);
+  }
+  else if (strcmp(method, kGetHistoryEntry) == 0)
+  {
+    auto *args = fl_method_call_get_args(method_call);
+    if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_INT)
+    {
+      fl_method_call_respond_error(method_call, "bad_args", "Expected an id", nullptr, nullptr);
+      return;
+    }
+    fl_rich_clipboard_plugin_respond_history_entry(self, method_call, fl_value_get_int(args));
+  }
   else
   {
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
@@ -214,8 +2925,53 @@ static void method_call_cb(FlMethodChannel *channel, FlMethodCall *method_call,
   }
 }
 
+static void fl_rich_clipboard_plugin_fail_native_reads(FlRichClipboardPlugin *self);
+
 static void fl_rich_clipboard_plugin_dispose(GObject *object)
 {
+  auto *self = FL_MY_PLUGIN_PLUGIN(object);
+
+  if (nativePlugin == self)
+  {
+    nativePlugin = nullptr;
+  }
+  // Their transfers may never finish once the backend is gone.
+  fl_rich_clipboard_plugin_fail_native_reads(self);
+
+  // Do not lose a write that was still waiting to be installed.
+  fl_rich_clipboard_plugin_flush_writes(self);
+
+  // The data stays on the clipboard after we are gone, so only detach it.
+  if (self->ownedData != nullptr)
+  {
+    self->ownedData->owner = nullptr;
+    self->ownedData = nullptr;
+  }
+  g_clear_pointer(&self->cachedTypes, fl_value_unref);
+  g_clear_pointer(&self->cachedData, fl_value_unref);
+  delete self->cachedTargets;
+  self->cachedTargets = nullptr;
+  g_clear_pointer(&self->streams, g_hash_table_unref);
+  g_clear_pointer(&self->pendingCalls, g_ptr_array_unref);
+  g_clear_pointer(&self->storeCalls, g_ptr_array_unref);
+  g_clear_pointer(&self->nativeReads, g_ptr_array_unref);
+  g_clear_handle_id(&self->primaryTimeout, g_source_remove);
+  delete self->pendingPrimary;
+  self->pendingPrimary = nullptr;
+  if (self->primaryData != nullptr)
+  {
+    self->primaryData->owner = nullptr;
+    self->primaryData = nullptr;
+  }
+  delete self->backend;
+  self->backend = nullptr;
+  delete self->stats;
+  self->stats = nullptr;
+  delete self->history;
+  self->history = nullptr;
+  delete self->atoms;
+  self->atoms = nullptr;
+
   G_OBJECT_CLASS(fl_rich_clipboard_plugin_parent_class)->dispose(object);
 }
 
@@ -224,12 +2980,23 @@ static void fl_rich_clipboard_plugin_class_init(FlRichClipboardPluginClass *klas
   G_OBJECT_CLASS(klass)->dispose = fl_rich_clipboard_plugin_dispose;
 }
 
-FlRichClipboardPlugin *fl_rich_clipboard_plugin_new(FlPluginRegistrar *registrar)
+FlRichClipboardPlugin *fl_rich_clipboard_plugin_new_with_backend(
+    FlPluginRegistrar *registrar,
+    ClipboardBackend *backend)
 {
   FlRichClipboardPlugin *self = FL_MY_PLUGIN_PLUGIN(
       g_object_new(fl_rich_clipboard_plugin_get_type(), nullptr));
 
   self->registrar = FL_PLUGIN_REGISTRAR(g_object_ref(registrar));
+  nativePlugin = self;
+
+  self->backend = backend;
+  self->canCacheSnapshot = backend->reportsOwnerChanges();
+  backend->setOwnerChangeCallback(
+      [self](guint32 selectionTime)
+      {
+        fl_rich_clipboard_plugin_owner_changed(self, selectionTime);
+      });
 
   g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
   self->channel =
@@ -238,13 +3005,252 @@ FlRichClipboardPlugin *fl_rich_clipboard_plugin_new(FlPluginRegistrar *registrar
   fl_method_channel_set_method_call_handler(self->channel, method_call_cb,
                                             g_object_ref(self), g_object_unref);
 
+  self->changesChannel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           kChangesChannelName, FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(self->changesChannel, changes_listen_cb,
+                                       changes_cancel_cb, g_object_ref(self),
+                                       g_object_unref);
+
   return self;
 }
 
-static void fl_rich_clipboard_plugin_init(FlRichClipboardPlugin *self) {}
+FlRichClipboardPlugin *fl_rich_clipboard_plugin_new(FlPluginRegistrar *registrar)
+{
+#ifdef RICH_CLIPBOARD_LINUX_WAYLAND
+  // In a Wayland session the compositor is asked directly when it allows it,
+  // even if GDK itself runs on XWayland.
+  if (g_getenv("WAYLAND_DISPLAY") != nullptr)
+  {
+    auto *backend = new WaylandClipboardBackend();
+    if (backend->isConnected())
+    {
+      return fl_rich_clipboard_plugin_new_with_backend(registrar, backend);
+    }
+    delete backend;
+  }
+#endif
+  return fl_rich_clipboard_plugin_new_with_backend(registrar, new GtkClipboardBackend(gdk_display_get_default()));
+}
+
+static void fl_rich_clipboard_plugin_init(FlRichClipboardPlugin *self)
+{
+  self->streams = g_hash_table_new_full(g_direct_hash, g_direct_equal, nullptr, data_stream_free);
+  self->storeCalls = g_ptr_array_new_with_free_func(g_object_unref);
+  self->pendingCalls = g_ptr_array_new_with_free_func(g_object_unref);
+  self->nativeReads = g_ptr_array_new();
+  self->stats = new ClipboardStats();
+  self->atoms = new AtomTable();
+}
 
 void rich_clipboard_plugin_register_with_registrar(FlPluginRegistrar *registrar)
 {
   FlRichClipboardPlugin *plugin = fl_rich_clipboard_plugin_new(registrar);
   g_object_unref(plugin);
 }
+
+// A rich_clipboard_read_data call. The calling thread waits on cond until
+// the main loop has set done, or until it gives up. Both sides hold a
+// reference, since either may be the last to let go.
+struct NativeRead
+{
+  string mimeType;
+  GMutex mutex;
+  GCond cond;
+  // Guarded by mutex.
+  int refs = 1;
+  bool done = false;
+  // Set once the calling thread stopped waiting.
+  bool abandoned = false;
+  RichClipboardReadResult result = RICH_CLIPBOARD_READ_NOT_AVAILABLE;
+  guint8 *data = nullptr;
+  gsize length = 0;
+  // The plugin serving the read, until the read is done. Main loop only.
+  FlRichClipboardPlugin *plugin = nullptr;
+
+  NativeRead(const char *mimeType)
+      : mimeType(mimeType)
+  {
+    g_mutex_init(&mutex);
+    g_cond_init(&cond);
+  }
+  ~NativeRead()
+  {
+    g_free(data);
+    g_cond_clear(&cond);
+    g_mutex_clear(&mutex);
+  }
+  NativeRead(const NativeRead &) = delete;
+  NativeRead &operator=(const NativeRead &) = delete;
+};
+
+static NativeRead *native_read_ref(NativeRead *read)
+{
+  g_mutex_lock(&read->mutex);
+  read->refs++;
+  g_mutex_unlock(&read->mutex);
+  return read;
+}
+
+static void native_read_unref(NativeRead *read)
+{
+  g_mutex_lock(&read->mutex);
+  bool last = --read->refs == 0;
+  g_mutex_unlock(&read->mutex);
+  if (last)
+  {
+    delete read;
+  }
+}
+
+// Hands the outcome of read to the calling thread, unless it was decided
+// already or the caller stopped waiting.
+static void native_read_finish(NativeRead *read, RichClipboardReadResult result, const guchar *data, gsize length)
+{
+  if (read->plugin != nullptr)
+  {
+    g_ptr_array_remove_fast(read->plugin->nativeReads, read);
+    read->plugin = nullptr;
+  }
+
+  g_mutex_lock(&read->mutex);
+  if (!read->done && !read->abandoned)
+  {
+    read->result = result;
+    if (result == RICH_CLIPBOARD_READ_OK)
+    {
+      // Dart frees the copy once the Uint8List it wraps is collected.
+      read->data = static_cast<guint8 *>(g_malloc(MAX(length, 1)));
+      memcpy(read->data, data, length);
+      read->length = length;
+    }
+  }
+  read->done = true;
+  g_cond_signal(&read->cond);
+  g_mutex_unlock(&read->mutex);
+}
+
+static void fl_rich_clipboard_plugin_fail_native_reads(FlRichClipboardPlugin *self)
+{
+  while (self->nativeReads != nullptr && self->nativeReads->len > 0)
+  {
+    native_read_finish(
+        static_cast<NativeRead *>(g_ptr_array_index(self->nativeReads, 0)), RICH_CLIPBOARD_READ_NO_PLUGIN, nullptr,
+        0);
+  }
+}
+
+// Starts the transfer of a rich_clipboard_read_data call on the main loop,
+// and takes over the reference to read it was given.
+static gboolean native_read_start_cb(gpointer user_data)
+{
+  auto *read = static_cast<NativeRead *>(user_data);
+  auto *self = nativePlugin;
+  g_mutex_lock(&read->mutex);
+  bool abandoned = read->abandoned;
+  g_mutex_unlock(&read->mutex);
+  if (self == nullptr || abandoned)
+  {
+    native_read_finish(read, RICH_CLIPBOARD_READ_NO_PLUGIN, nullptr, 0);
+    native_read_unref(read);
+    return G_SOURCE_REMOVE;
+  }
+
+  // Like a method call, the read has to see the last write first.
+  fl_rich_clipboard_plugin_flush_writes(self);
+
+  read->plugin = self;
+  g_ptr_array_add(self->nativeReads, read);
+  g_object_ref(self);
+  auto start = g_get_monotonic_time();
+  auto finish = [self, read, start](const guchar *data, gsize length)
+  {
+    // A plugin that went away has failed the read already.
+    if (read->plugin != nullptr)
+    {
+      self->stats->recordCall(kNativeReadData, g_get_monotonic_time() - start);
+      native_read_finish(
+          read, data != nullptr ? RICH_CLIPBOARD_READ_OK : RICH_CLIPBOARD_READ_NOT_AVAILABLE, data, length);
+    }
+    native_read_unref(read);
+    g_object_unref(self);
+  };
+  if (self->ownedData != nullptr)
+  {
+    fl_rich_clipboard_plugin_with_owned_data(
+        self, {read->mimeType},
+        [read, finish](RichClipboardData *clipboardData)
+        {
+          auto *buffer = clipboardData->getBuiltBuffer(read->mimeType.c_str());
+          finish(buffer != nullptr ? buffer->getData() : nullptr, buffer != nullptr ? buffer->getLength() : 0);
+        });
+  }
+  else
+  {
+    fl_rich_clipboard_plugin_read_type(
+        self, GDK_SELECTION_CLIPBOARD, read->mimeType,
+        [self, read, finish](const guchar *data, gsize length, GBytes *bytes)
+        {
+          if (data != nullptr && read->plugin != nullptr)
+          {
+            self->stats->recordRead(read->mimeType, length);
+          }
+          finish(data, length);
+        });
+  }
+  return G_SOURCE_REMOVE;
+}
+
+int32_t rich_clipboard_read_data(const char *mime_type, uint8_t **data, size_t *length)
+{
+  auto *read = new NativeRead(mime_type);
+
+  auto *context = g_main_context_default();
+  if (g_main_context_is_owner(context))
+  {
+    // Called from the main thread, e.g. by a root isolate that shares it, so
+    // run the loop here until the transfer is done.
+    native_read_start_cb(native_read_ref(read));
+    bool timedOut = false;
+    auto timeoutId = g_timeout_add(kNativeReadTimeoutMs, promise_timeout_cb, &timedOut);
+    while (!read->done && !timedOut)
+    {
+      g_main_context_iteration(context, TRUE);
+    }
+    if (!timedOut)
+    {
+      g_source_remove(timeoutId);
+    }
+    g_mutex_lock(&read->mutex);
+  }
+  else
+  {
+    // g_main_context_invoke would run the read on this thread if the main
+    // thread happens to be idle, so always go through an idle source.
+    g_idle_add(native_read_start_cb, native_read_ref(read));
+    auto deadline = g_get_monotonic_time() + kNativeReadTimeoutMs * G_TIME_SPAN_MILLISECOND;
+    g_mutex_lock(&read->mutex);
+    while (!read->done && g_cond_wait_until(&read->cond, &read->mutex, deadline))
+    {
+    }
+  }
+
+  // The transfer may still finish after this, and is then dropped.
+  read->abandoned = true;
+  auto result = read->done ? read->result : RICH_CLIPBOARD_READ_TIMED_OUT;
+  *data = read->data;
+  *length = read->length;
+  read->data = nullptr;
+  g_mutex_unlock(&read->mutex);
+  if (result == RICH_CLIPBOARD_READ_TIMED_OUT)
+  {
+    g_warning("Timed out reading %s from the clipboard", mime_type);
+  }
+  native_read_unref(read);
+  return result;
+}
+
+void rich_clipboard_free_data(void *data)
+{
+  g_free(data);
+}
@@ -0,0 +1,15 @@
+#ifndef FLUTTER_PLUGIN_RICH_CLIPBOARD_LINUX_PLUGIN_PRIVATE_H_
+#define FLUTTER_PLUGIN_RICH_CLIPBOARD_LINUX_PLUGIN_PRIVATE_H_
+
+#include "include/rich_clipboard_linux/rich_clipboard_plugin.h"
+
+#include "clipboard_backend.h"
+
+// Creates the plugin on top of backend instead of the system clipboard, e.g.
+// to benchmark it against a MemoryClipboardBackend. The plugin takes
+// ownership of backend.
+FlRichClipboardPlugin *fl_rich_clipboard_plugin_new_with_backend(
+    FlPluginRegistrar *registrar,
+    ClipboardBackend *backend);
+
+#endif  // FLUTTER_PLUGIN_RICH_CLIPBOARD_LINUX_PLUGIN_PRIVATE_H_
@@ -0,0 +1,200 @@
+#include "clipboard_history.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static ClipboardHistory::FormatView view(const char *mimeType, const string &data)
+{
+  return {mimeType, reinterpret_cast<const guchar *>(data.data()), data.size()};
+}
+
+static unique_ptr<ClipboardHistory::Snapshot> pack_text(const string &text)
+{
+  return ClipboardHistory::pack({view("text/plain", text)});
+}
+
+// Bytes that do not compress.
+static string noise(gsize length)
+{
+  string bytes(length, '\0');
+  guint32 state = 2463534242u;
+  for (auto &byte : bytes)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    byte = static_cast<char>(state);
+  }
+  return bytes;
+}
+
+static string lookup_string(FlValue *map, const char *key)
+{
+  auto *value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING)
+  {
+    return "<missing>";
+  }
+  return string(fl_value_get_string(value), fl_value_get_length(value));
+}
+
+// Lists the ids of the history, newest first.
+static vector<guint64> list_ids(ClipboardHistory &history, guint64 beforeId = 0, gsize limit = 100)
+{
+  vector<guint64> ids;
+  auto *list = history.listValue(beforeId, limit);
+  for (size_t i = 0; i < fl_value_get_length(list); i++)
+  {
+    auto *item = fl_value_get_list_value(list, i);
+    ids.push_back(fl_value_get_int(fl_value_lookup_string(item, "id")));
+  }
+  fl_value_unref(list);
+  return ids;
+}
+
+TEST(ClipboardHistoryTest, PacksAndUnpacksFormats)
+{
+  string text = "hello";
+  string html = "<b>hello</b>";
+  string empty;
+  auto snapshot = ClipboardHistory::pack({view("text/plain", text), view("text/html", html), view("x-empty", empty)});
+  ASSERT_EQ(snapshot->formats.size(), 3u);
+  EXPECT_EQ(snapshot->formats[1].mimeType, "text/html");
+  EXPECT_EQ(snapshot->formats[1].length, html.size());
+  EXPECT_EQ(snapshot->preview, "hello");
+
+  auto *value = ClipboardHistory::unpack(*snapshot);
+  ASSERT_EQ(fl_value_get_type(value), FL_VALUE_TYPE_MAP);
+  EXPECT_EQ(fl_value_get_length(value), 3u);
+  EXPECT_EQ(lookup_string(value, "text/plain"), text);
+  EXPECT_EQ(lookup_string(value, "text/html"), html);
+  EXPECT_EQ(lookup_string(value, "x-empty"), "");
+  fl_value_unref(value);
+}
+
+TEST(ClipboardHistoryTest, PacksNoFormats)
+{
+  auto snapshot = ClipboardHistory::pack({});
+  auto *value = ClipboardHistory::unpack(*snapshot);
+  ASSERT_EQ(fl_value_get_type(value), FL_VALUE_TYPE_MAP);
+  EXPECT_EQ(fl_value_get_length(value), 0u);
+  fl_value_unref(value);
+}
+
+TEST(ClipboardHistoryTest, CompressesRepetitiveFormats)
+{
+  string text;
+  for (int i = 0; i < 10000; i++)
+  {
+    text += "line " + to_string(i % 10) + "\n";
+  }
+  string html = "<pre>" + text + "</pre>";
+  auto snapshot = ClipboardHistory::pack({view("text/plain", text), view("text/html", html)});
+  EXPECT_TRUE(snapshot->compressed);
+  EXPECT_LT(g_bytes_get_size(snapshot->block), text.size() / 10);
+
+  auto *value = ClipboardHistory::unpack(*snapshot);
+  EXPECT_EQ(lookup_string(value, "text/plain"), text);
+  EXPECT_EQ(lookup_string(value, "text/html"), html);
+  fl_value_unref(value);
+}
+
+TEST(ClipboardHistoryTest, StoresIncompressibleFormatsAsTheyAre)
+{
+  auto data = noise(4096);
+  auto snapshot = ClipboardHistory::pack({view("application/octet-stream", data)});
+  EXPECT_FALSE(snapshot->compressed);
+  EXPECT_EQ(g_bytes_get_size(snapshot->block), data.size());
+
+  auto *value = ClipboardHistory::unpack(*snapshot);
+  EXPECT_EQ(lookup_string(value, "application/octet-stream"), data);
+  fl_value_unref(value);
+}
+
+TEST(ClipboardHistoryTest, CutsPreviewBetweenCharacters)
+{
+  // U+00E9 straddles the 120th byte.
+  auto snapshot = pack_text(string(119, 'a') + "\xc3\xa9" + "b");
+  EXPECT_EQ(snapshot->preview, string(119, 'a'));
+  EXPECT_EQ(pack_text(string(120, 'a'))->preview, string(120, 'a'));
+  EXPECT_TRUE(ClipboardHistory::pack({view("text/html", "<b>a</b>")})->preview.empty());
+}
+
+TEST(ClipboardHistoryTest, HashesTypesAlongWithBytes)
+{
+  string data = "same";
+  EXPECT_EQ(pack_text(data)->hash, pack_text(data)->hash);
+  EXPECT_NE(pack_text(data)->hash, ClipboardHistory::pack({view("text/html", data)})->hash);
+  // Moving bytes from one format to the next is a different snapshot too.
+  EXPECT_NE(
+      ClipboardHistory::pack({view("a", "xy"), view("b", "z")})->hash,
+      ClipboardHistory::pack({view("a", "x"), view("b", "yz")})->hash);
+}
+
+TEST(ClipboardHistoryTest, ListsNewestFirstInPages)
+{
+  ClipboardHistory history(1024 * 1024);
+  for (int i = 0; i < 5; i++)
+  {
+    history.add(pack_text("entry " + to_string(i)));
+  }
+  EXPECT_EQ(list_ids(history), vector<guint64>({5, 4, 3, 2, 1}));
+  EXPECT_EQ(list_ids(history, 0, 2), vector<guint64>({5, 4}));
+  EXPECT_EQ(list_ids(history, 4, 2), vector<guint64>({3, 2}));
+  EXPECT_EQ(list_ids(history, 2, 2), vector<guint64>({1}));
+
+  auto *list = history.listValue(0, 1);
+  auto *item = fl_value_get_list_value(list, 0);
+  EXPECT_EQ(lookup_string(item, "preview"), "entry 4");
+  auto *types = fl_value_lookup_string(item, "types");
+  EXPECT_EQ(fl_value_get_int(fl_value_lookup_string(types, "text/plain")), 7);
+  fl_value_unref(list);
+}
+
+TEST(ClipboardHistoryTest, MovesDuplicatesToTheTop)
+{
+  ClipboardHistory history(1024 * 1024);
+  history.add(pack_text("a"));
+  history.add(pack_text("b"));
+  history.add(pack_text("a"));
+  EXPECT_EQ(list_ids(history), vector<guint64>({3, 2}));
+  EXPECT_EQ(history.find(1), nullptr);
+}
+
+TEST(ClipboardHistoryTest, EvictsOldestOverBudget)
+{
+  auto entrySize = pack_text(noise(1000))->getSize();
+  ClipboardHistory history(entrySize * 3);
+  for (int i = 0; i < 5; i++)
+  {
+    history.add(pack_text(noise(999) + static_cast<char>(i)));
+  }
+  EXPECT_EQ(list_ids(history), vector<guint64>({5, 4, 3}));
+  EXPECT_EQ(history.find(2), nullptr);
+  ASSERT_NE(history.find(3), nullptr);
+  EXPECT_EQ(history.find(3)->id, 3u);
+
+  history.setMaxBytes(entrySize);
+  EXPECT_EQ(list_ids(history), vector<guint64>({5}));
+
+  // A snapshot larger than the whole budget does not stay either.
+  history.add(pack_text(noise(2000)));
+  EXPECT_TRUE(list_ids(history).empty());
+}
+
+TEST(ClipboardHistoryTest, KeepsFetchedSnapshotsAliveAfterEviction)
+{
+  ClipboardHistory history(1024 * 1024);
+  history.add(pack_text("kept"));
+  auto snapshot = history.find(1);
+  history.clear();
+  EXPECT_EQ(history.find(1), nullptr);
+
+  auto *value = ClipboardHistory::unpack(*snapshot);
+  EXPECT_EQ(lookup_string(value, "text/plain"), "kept");
+  fl_value_unref(value);
+}
@@ -0,0 +1,68 @@
+#include "content_hash.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static guint64 hash_string(const string &data, guint64 seed = 0)
+{
+  return content_hash(data.data(), data.size(), seed);
+}
+
+// The XXH64 test vectors published with xxHash and its Python binding.
+TEST(ContentHashTest, MatchesXxh64Vectors)
+{
+  EXPECT_EQ(hash_string(""), G_GUINT64_CONSTANT(0xef46db3751d8e999));
+  EXPECT_EQ(hash_string("a"), G_GUINT64_CONSTANT(0xd24ec4f1a98c6e5b));
+  EXPECT_EQ(hash_string("abc"), G_GUINT64_CONSTANT(0x44bc2cf5ad770999));
+  EXPECT_EQ(hash_string("Nobody inspects the spammish repetition"), G_GUINT64_CONSTANT(0xfbcea83c8a378bf1));
+}
+
+// Covers the seed and the four-lane loop over 32-byte stripes.
+TEST(ContentHashTest, MatchesSeededAndLongVectors)
+{
+  string bytes;
+  for (int i = 0; i < 1024; i++)
+  {
+    bytes += static_cast<char>(i & 0xff);
+  }
+  EXPECT_EQ(hash_string("", 1), G_GUINT64_CONSTANT(0xd5afba1336a3be4b));
+  EXPECT_EQ(hash_string("Nobody inspects the spammish repetition", 20141025), G_GUINT64_CONSTANT(0xce06936136852706));
+  EXPECT_EQ(hash_string(bytes), G_GUINT64_CONSTANT(0x6f3914f18fe4df57));
+  EXPECT_EQ(hash_string(bytes, G_GUINT64_CONSTANT(0x9e3779b97f4a7c15)), G_GUINT64_CONSTANT(0x22d0f4503bcda26a));
+}
+
+TEST(ContentHashTest, DoesNotDependOnAlignment)
+{
+  string bytes(200, '\0');
+  for (size_t i = 0; i < bytes.size(); i++)
+  {
+    bytes[i] = static_cast<char>(i * 7);
+  }
+  vector<guchar> shifted(bytes.size() + 8);
+  for (size_t offset = 1; offset < 8; offset++)
+  {
+    copy(bytes.begin(), bytes.end(), shifted.begin() + offset);
+    EXPECT_EQ(content_hash(shifted.data() + offset, bytes.size()), hash_string(bytes));
+  }
+}
+
+TEST(ContentHashTest, TellsLengthsApart)
+{
+  // Every length goes through a different mix of stripes, words and bytes.
+  string bytes(64, 'x');
+  vector<guint64> hashes;
+  for (size_t length = 0; length <= bytes.size(); length++)
+  {
+    auto hash = content_hash(bytes.data(), length);
+    for (auto other : hashes)
+    {
+      EXPECT_NE(hash, other) << "length " << length;
+    }
+    hashes.push_back(hash);
+  }
+}
@@ -0,0 +1,154 @@
+#include "html_decoder.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace std;
+
+// Encodes text as UTF-16 without a byte order mark.
+static string utf16(const u16string &text, bool bigEndian = false)
+{
+  string bytes;
+  for (auto unit : text)
+  {
+    auto high = static_cast<char>(unit >> 8);
+    auto low = static_cast<char>(unit & 0xff);
+    bytes += bigEndian ? high : low;
+    bytes += bigEndian ? low : high;
+  }
+  return bytes;
+}
+
+// Decodes data read from target, and returns what getData would hand to
+// Dart.
+static string decode(const string &data, const gchar *target = "text/html")
+{
+  string decoded;
+  if (!decode_html(reinterpret_cast<const guchar *>(data.data()), data.size(), target, decoded))
+  {
+    return data;
+  }
+  return decoded;
+}
+
+TEST(HtmlDecoderTest, LeavesUtf8WithLfAlone)
+{
+  string decoded;
+  string html = "<p>caf\xc3\xa9</p>\n";
+  EXPECT_FALSE(decode_html(reinterpret_cast<const guchar *>(html.data()), html.size(), "text/html", decoded));
+}
+
+TEST(HtmlDecoderTest, NormalizesLineEndings)
+{
+  EXPECT_EQ(decode("<p>a</p>\r\n<p>b</p>\r<p>c</p>"), "<p>a</p>\n<p>b</p>\n<p>c</p>");
+}
+
+TEST(HtmlDecoderTest, StripsUtf8Bom)
+{
+  EXPECT_EQ(decode("\xef\xbb\xbf<p>a</p>"), "<p>a</p>");
+}
+
+TEST(HtmlDecoderTest, ReadsUtf16Boms)
+{
+  EXPECT_EQ(decode("\xff\xfe" + utf16(u"<p>café</p>")), "<p>caf\xc3\xa9</p>");
+  EXPECT_EQ(decode("\xfe\xff" + utf16(u"<p>café</p>", true)), "<p>caf\xc3\xa9</p>");
+}
+
+TEST(HtmlDecoderTest, BomOverridesCharsetOfTarget)
+{
+  EXPECT_EQ(decode("\xef\xbb\xbf<p>a</p>", "text/html;charset=utf-16"), "<p>a</p>");
+}
+
+TEST(HtmlDecoderTest, ReadsCharsetOfTarget)
+{
+  EXPECT_EQ(decode(utf16(u"<p>a</p>"), "text/html;charset=utf-16"), "<p>a</p>");
+  EXPECT_EQ(decode(utf16(u"<p>a</p>", true), "text/html; charset=\"UTF-16BE\""), "<p>a</p>");
+  EXPECT_EQ(decode("<p>caf\xe9</p>", "text/html;charset=iso-8859-1"), "<p>caf\xc3\xa9</p>");
+}
+
+TEST(HtmlDecoderTest, CharsetOfTargetOverridesMeta)
+{
+  EXPECT_EQ(
+      decode("<meta charset=\"windows-1252\"><p>caf\xc3\xa9</p>", "text/html;charset=utf-8"),
+      "<meta charset=\"windows-1252\"><p>caf\xc3\xa9</p>");
+}
+
+TEST(HtmlDecoderTest, GuessesUtf16FromZeroBytes)
+{
+  EXPECT_EQ(decode(utf16(u"<html><body>a</body></html>")), "<html><body>a</body></html>");
+  EXPECT_EQ(decode(utf16(u"<html><body>a</body></html>", true)), "<html><body>a</body></html>");
+}
+
+TEST(HtmlDecoderTest, ReadsMetaCharset)
+{
+  EXPECT_EQ(decode("<meta charset=\"iso-8859-1\"><p>caf\xe9</p>"), "<meta charset=\"iso-8859-1\"><p>caf\xc3\xa9</p>");
+  EXPECT_EQ(
+      decode("<meta http-equiv=\"Content-Type\" content=\"text/html; charset=iso-8859-1\">\xe9"),
+      "<meta http-equiv=\"Content-Type\" content=\"text/html; charset=iso-8859-1\">\xc3\xa9");
+}
+
+TEST(HtmlDecoderTest, IgnoresMetaCharsetPastPrescan)
+{
+  string html = string(1024, ' ') + "<meta charset=\"iso-8859-1\">";
+  EXPECT_EQ(decode(html), html);
+}
+
+TEST(HtmlDecoderTest, RepairsInvalidUtf8)
+{
+  EXPECT_EQ(decode("<p>a\xff"
+                   "b</p>"),
+            "<p>a\xef\xbf\xbd"
+            "b</p>");
+}
+
+// UTF-16 is read four units at a time, so cover every length of the tail and
+// a CR or non-ASCII unit in each lane.
+TEST(HtmlDecoderTest, ReadsUtf16TailsAndLanes)
+{
+  u16string text = u"abcdefgh";
+  string expected = "abcdefgh";
+  for (size_t length = 0; length <= text.size(); length++)
+  {
+    EXPECT_EQ(decode(utf16(text.substr(0, length)), "text/html;charset=utf-16"), expected.substr(0, length));
+  }
+  for (size_t lane = 0; lane < 4; lane++)
+  {
+    auto crlf = text;
+    crlf.replace(lane, 1, u"\r\n");
+    auto crlfExpected = expected;
+    crlfExpected.replace(lane, 1, "\n");
+    EXPECT_EQ(decode(utf16(crlf), "text/html;charset=utf-16"), crlfExpected);
+
+    auto accented = text;
+    accented[lane] = u'é';
+    auto accentedExpected = expected;
+    accentedExpected.replace(lane, 1, "\xc3\xa9");
+    EXPECT_EQ(decode(utf16(accented, true), "text/html;charset=utf-16be"), accentedExpected);
+  }
+}
+
+TEST(HtmlDecoderTest, ReadsUtf16Surrogates)
+{
+  EXPECT_EQ(decode(utf16(u"a\U0001f600b"), "text/html;charset=utf-16"), "a\xf0\x9f\x98\x80"
+                                                                          "b");
+  // Unpaired halves, including a high surrogate cut off at the end.
+  EXPECT_EQ(decode(utf16(u"a\xdc00" u"b\xd800"), "text/html;charset=utf-16"),
+            "a\xef\xbf\xbd"
+            "b\xef\xbf\xbd");
+}
+
+TEST(HtmlDecoderTest, DropsOddTrailingByte)
+{
+  EXPECT_EQ(decode(utf16(u"ab") + "c", "text/html;charset=utf-16"), "ab");
+}
+
+TEST(HtmlDecoderTest, MatchesHtmlTargetsWithParameters)
+{
+  EXPECT_TRUE(is_html_target_with_parameters("text/html;charset=utf-16"));
+  EXPECT_TRUE(is_html_target_with_parameters("text/html ; charset=utf-8"));
+  EXPECT_TRUE(is_html_target_with_parameters("TEXT/HTML;charset=UTF-8"));
+  EXPECT_FALSE(is_html_target_with_parameters("text/html"));
+  EXPECT_FALSE(is_html_target_with_parameters("text/htmlx;charset=utf-8"));
+  EXPECT_FALSE(is_html_target_with_parameters("text/plain;charset=utf-8"));
+}
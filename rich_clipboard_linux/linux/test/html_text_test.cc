@@ -0,0 +1,95 @@
+#include "html_text.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace std;
+
+static string to_text(const string &html)
+{
+  return html_to_text(html.data(), html.size());
+}
+
+TEST(HtmlTextTest, CollapsesWhitespace)
+{
+  EXPECT_EQ(to_text("  <p>  one \n\t two  </p>  "), "one two");
+  EXPECT_EQ(to_text("<b>bold</b> <i>italic</i>"), "bold italic");
+}
+
+TEST(HtmlTextTest, BreaksLinesAtBlocks)
+{
+  EXPECT_EQ(to_text("<h1>Title</h1><p>One</p><p>Two</p>"), "Title\nOne\nTwo");
+  EXPECT_EQ(to_text("<div><div><p>Nested</p></div></div>After"), "Nested\nAfter");
+  EXPECT_EQ(to_text("a<br>b<br/><br>c"), "a\nb\n\nc");
+  EXPECT_EQ(to_text("<ul><li>a</li><li>b</li></ul>"), "a\nb");
+}
+
+TEST(HtmlTextTest, SeparatesTableCells)
+{
+  EXPECT_EQ(to_text("<table><tr><td>a</td><td>b</td></tr><tr><th>c</th><td>d</td></tr></table>"), "a\tb\nc\td");
+}
+
+TEST(HtmlTextTest, DecodesCharacterReferences)
+{
+  EXPECT_EQ(to_text("a &amp; b &lt;c&gt; &quot;d&quot;"), "a & b <c> \"d\"");
+  EXPECT_EQ(to_text("&copy;&#169;&#xA9;&#XA9;"), "\xc2\xa9\xc2\xa9\xc2\xa9\xc2\xa9");
+  EXPECT_EQ(to_text("&euro;&hellip;&nbsp;x"), "\xe2\x82\xac\xe2\x80\xa6 x");
+  // A missing semicolon is tolerated.
+  EXPECT_EQ(to_text("a &amp b"), "a & b");
+}
+
+TEST(HtmlTextTest, LeavesUnknownReferences)
+{
+  EXPECT_EQ(to_text("&unknown; & &#; &#x;"), "&unknown; & &#; &#x;");
+}
+
+TEST(HtmlTextTest, ReplacesInvalidNumericReferences)
+{
+  EXPECT_EQ(to_text("&#0;&#xd800;&#x110000;"), "\xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd");
+}
+
+TEST(HtmlTextTest, KeepsWhitespaceInPre)
+{
+  EXPECT_EQ(to_text("<p>before</p><pre>  a\r\n    b\n</pre><p>after  text</p>"), "before\n  a\n    b\nafter text");
+  EXPECT_EQ(to_text("<pre>a <b>b</b>  &lt;c&gt;</pre>"), "a b  <c>");
+}
+
+TEST(HtmlTextTest, DropsHiddenElements)
+{
+  EXPECT_EQ(
+      to_text("<html><head><title>T</title><style>p { color: red; }</style></head>"
+              "<body><script>if (a < b) {}</script><p>Shown</p><template><p>x</p></template></body></html>"),
+      "Shown");
+  EXPECT_EQ(to_text("<SCRIPT>a</SCRIPT >b"), "b");
+  // Only the matching closing tag ends the element.
+  EXPECT_EQ(to_text("<script>\"</scripts>\"</script>b"), "b");
+  // A self-closing hidden element has no contents.
+  EXPECT_EQ(to_text("<script/>a"), "a");
+}
+
+TEST(HtmlTextTest, DropsCommentsAndDeclarations)
+{
+  EXPECT_EQ(to_text("<!DOCTYPE html><?xml version=\"1.0\"?>a<!-- <p>b</p> -->c"), "ac");
+}
+
+TEST(HtmlTextTest, SkipsQuotedAngleBrackets)
+{
+  EXPECT_EQ(to_text("<a title=\"a > b\" href='c>d'>link</a>"), "link");
+}
+
+TEST(HtmlTextTest, KeepsStrayLessThan)
+{
+  EXPECT_EQ(to_text("a < b"), "a < b");
+  EXPECT_EQ(to_text("a <"), "a <");
+}
+
+TEST(HtmlTextTest, HandlesUnterminatedMarkup)
+{
+  EXPECT_EQ(to_text("a<p"), "a");
+  EXPECT_EQ(to_text("a<p title=\"b>c"), "a");
+  EXPECT_EQ(to_text("a<!-- b"), "a");
+  EXPECT_EQ(to_text("a<script>b"), "a");
+  EXPECT_EQ(to_text("a&amp"), "a&");
+  EXPECT_EQ(to_text("<pre>a\n"), "a");
+}
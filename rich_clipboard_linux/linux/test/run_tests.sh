@@ -0,0 +1,19 @@
+#!/usr/bin/env bash
+# Builds the native unit tests of the Linux plugin through the example app and
+# runs them.
+#
+# Needs flutter and GoogleTest. Arguments are passed on to ctest, for example
+# -R HtmlDecoder to run a single suite.
+set -euo pipefail
+
+root="$(cd "$(dirname "${BASH_SOURCE[0]}")/../../.." && pwd)"
+example="${root}/rich_clipboard/example"
+build="${example}/build/linux/x64/debug"
+
+# Generates the Flutter build files the plugin's CMake project relies on.
+(cd "${example}" && flutter build linux --debug)
+
+cmake -S "${example}/linux" -B "${build}" -DRICH_CLIPBOARD_LINUX_TESTS=ON
+cmake --build "${build}" --target rich_clipboard_linux_test
+
+ctest --test-dir "${build}/plugins/rich_clipboard_linux/test" --output-on-failure "$@"
@@ -0,0 +1,682 @@
+#include "wayland_clipboard_backend.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "ext-data-control-v1-client-protocol.h"
+
+using namespace std;
+
+// The one text target that is Latin-1 rather than UTF-8.
+const GdkAtom kGdkAtomString = gdk_atom_intern_static_string("STRING");
+
+// How much of a transfer is read at a time.
+const gsize kReadChunkLength = 64 * 1024;
+// A transfer fails once the other client has neither sent nor taken any bytes
+// for this long, so a client that never closes its end cannot hold up a
+// paste forever.
+const guint kTransferTimeoutMs = 10000;
+
+struct WaylandClipboardBackend::Transfer
+{
+  WaylandClipboardBackend *backend;
+  int fd;
+  guint watch = 0;
+  guint timeout = 0;
+  // Whether any bytes moved since transferTimeoutCb last ran.
+  bool progressed = false;
+  // Reads only: the bytes read so far.
+  string data;
+  // Writes only: the bytes to write, which are written up to offset.
+  GBytes *bytes = nullptr;
+  gsize offset = 0;
+  // Reads only: the target being read, whether it is converted to UTF-8, and
+  // who gets it.
+  GdkAtom target = GDK_NONE;
+  bool text = false;
+  ContentsCallback callback;
+};
+
+WaylandClipboardBackend::WaylandClipboardBackend(const char *displayName)
+    : display(wl_display_connect(displayName))
+{
+  if (display == nullptr)
+  {
+    return;
+  }
+
+  static const wl_registry_listener registryListener = {
+      registryGlobalCb,
+      registryGlobalRemoveCb,
+  };
+  registry = wl_display_get_registry(display);
+  wl_registry_add_listener(registry, &registryListener, this);
+  if (wl_display_roundtrip(display) < 0 || manager == nullptr || seat == nullptr)
+  {
+    disconnect();
+    return;
+  }
+
+  static const ext_data_control_device_v1_listener deviceListener = {
+      deviceDataOfferCb,
+      deviceSelectionCb,
+      deviceFinishedCb,
+      devicePrimarySelectionCb,
+  };
+  device = ext_data_control_manager_v1_get_data_device(manager, seat);
+  ext_data_control_device_v1_add_listener(device, &deviceListener, this);
+  // The compositor answers with the current selections, so they are known
+  // before the first request.
+  if (wl_display_roundtrip(display) < 0)
+  {
+    disconnect();
+    return;
+  }
+
+  displayWatch = g_unix_fd_add(
+      wl_display_get_fd(display),
+      static_cast<GIOCondition>(G_IO_IN | G_IO_ERR | G_IO_HUP),
+      displayCb,
+      this);
+}
+
+WaylandClipboardBackend::~WaylandClipboardBackend()
+{
+  auto pending = transfers;
+  for (auto *transfer : pending)
+  {
+    transfer->callback = nullptr;
+    finishTransfer(transfer, false);
+  }
+  disconnect();
+  // Data set while disconnected was only ever served locally.
+  release(clipboard);
+  release(primary);
+}
+
+void WaylandClipboardBackend::closeDevice()
+{
+  for (auto &entry : newOffers)
+  {
+    ext_data_control_offer_v1_destroy(entry.first);
+  }
+  newOffers.clear();
+  for (auto *selection : {&clipboard, &primary})
+  {
+    setOffer(*selection, nullptr);
+    release(*selection);
+  }
+  g_clear_pointer(&device, ext_data_control_device_v1_destroy);
+}
+
+void WaylandClipboardBackend::disconnect()
+{
+  g_clear_handle_id(&displayWatch, g_source_remove);
+  closeDevice();
+  g_clear_pointer(&manager, ext_data_control_manager_v1_destroy);
+  g_clear_pointer(&seat, wl_seat_destroy);
+  g_clear_pointer(&registry, wl_registry_destroy);
+  g_clear_pointer(&display, wl_display_disconnect);
+}
+
+void WaylandClipboardBackend::flush()
+{
+  if (display != nullptr)
+  {
+    wl_display_flush(display);
+  }
+}
+
+bool WaylandClipboardBackend::isConnected()
+{
+  return device != nullptr;
+}
+
+WaylandClipboardBackend::Selection &WaylandClipboardBackend::getSelection(GdkAtom selection)
+{
+  return selection == GDK_SELECTION_PRIMARY ? primary : clipboard;
+}
+
+WaylandClipboardBackend::Selection *WaylandClipboardBackend::findSelection(ext_data_control_source_v1 *dataSource)
+{
+  if (dataSource == clipboard.dataSource)
+  {
+    return &clipboard;
+  }
+  if (dataSource == primary.dataSource)
+  {
+    return &primary;
+  }
+  return nullptr;
+}
+
+void WaylandClipboardBackend::publish(GdkAtom selection, ext_data_control_source_v1 *dataSource)
+{
+  if (selection == GDK_SELECTION_PRIMARY)
+  {
+    ext_data_control_device_v1_set_primary_selection(device, dataSource);
+  }
+  else
+  {
+    ext_data_control_device_v1_set_selection(device, dataSource);
+  }
+  flush();
+}
+
+void WaylandClipboardBackend::release(Selection &selection)
+{
+  g_clear_pointer(&selection.dataSource, ext_data_control_source_v1_destroy);
+  selection.targets.clear();
+  auto *source = selection.source;
+  selection.source = nullptr;
+  if (source != nullptr)
+  {
+    source->clear();
+  }
+}
+
+void WaylandClipboardBackend::setOffer(Selection &selection, ext_data_control_offer_v1 *offer)
+{
+  g_clear_pointer(&selection.offer, ext_data_control_offer_v1_destroy);
+  selection.offerTargets.clear();
+  selection.offer = offer;
+  auto announced = newOffers.find(offer);
+  if (announced != newOffers.end())
+  {
+    selection.offerTargets = move(announced->second);
+    newOffers.erase(announced);
+  }
+}
+
+gboolean WaylandClipboardBackend::displayCb(gint fd, GIOCondition condition, gpointer user_data)
+{
+  auto *backend = static_cast<WaylandClipboardBackend *>(user_data);
+  if ((condition & (G_IO_ERR | G_IO_HUP)) != 0 || wl_display_dispatch(backend->display) < 0)
+  {
+    g_warning("Lost the connection to the Wayland compositor");
+    backend->displayWatch = 0;
+    backend->disconnect();
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+void WaylandClipboardBackend::registryGlobalCb(
+    void *data,
+    wl_registry *registry,
+    uint32_t name,
+    const char *interface,
+    uint32_t version)
+{
+  auto *backend = static_cast<WaylandClipboardBackend *>(data);
+  if (backend->seat == nullptr && strcmp(interface, wl_seat_interface.name) == 0)
+  {
+    backend->seat = static_cast<wl_seat *>(wl_registry_bind(registry, name, &wl_seat_interface, 1));
+  }
+  else if (backend->manager == nullptr && strcmp(interface, ext_data_control_manager_v1_interface.name) == 0)
+  {
+    backend->manager = static_cast<ext_data_control_manager_v1 *>(
+        wl_registry_bind(registry, name, &ext_data_control_manager_v1_interface, 1));
+  }
+}
+
+// A seat that goes away is reported by its device as finished.
+void WaylandClipboardBackend::registryGlobalRemoveCb(void *data, wl_registry *registry, uint32_t name) {}
+
+void WaylandClipboardBackend::deviceDataOfferCb(
+    void *data,
+    ext_data_control_device_v1 *device,
+    ext_data_control_offer_v1 *offer)
+{
+  static const ext_data_control_offer_v1_listener offerListener = {
+      offerOfferCb,
+  };
+  auto *backend = static_cast<WaylandClipboardBackend *>(data);
+  backend->newOffers[offer];
+  ext_data_control_offer_v1_add_listener(offer, &offerListener, backend);
+}
+
+void WaylandClipboardBackend::offerOfferCb(void *data, ext_data_control_offer_v1 *offer, const char *mimeType)
+{
+  auto *backend = static_cast<WaylandClipboardBackend *>(data);
+  auto announced = backend->newOffers.find(offer);
+  if (announced != backend->newOffers.end())
+  {
+    announced->second.push_back(gdk_atom_intern(mimeType, FALSE));
+  }
+}
+
+void WaylandClipboardBackend::deviceSelectionCb(
+    void *data,
+    ext_data_control_device_v1 *device,
+    ext_data_control_offer_v1 *offer)
+{
+  auto *backend = static_cast<WaylandClipboardBackend *>(data);
+  backend->setOffer(backend->clipboard, offer);
+  if (backend->ownerChangeCallback)
+  {
+    backend->ownerChangeCallback(0);
+  }
+}
+
+void WaylandClipboardBackend::devicePrimarySelectionCb(
+    void *data,
+    ext_data_control_device_v1 *device,
+    ext_data_control_offer_v1 *offer)
+{
+  auto *backend = static_cast<WaylandClipboardBackend *>(data);
+  backend->setOffer(backend->primary, offer);
+}
+
+// The seat went away, and its clipboard with it. The connection itself cannot
+// be closed while it is dispatching this event.
+void WaylandClipboardBackend::deviceFinishedCb(void *data, ext_data_control_device_v1 *device)
+{
+  auto *backend = static_cast<WaylandClipboardBackend *>(data);
+  backend->closeDevice();
+  if (backend->ownerChangeCallback)
+  {
+    backend->ownerChangeCallback(0);
+  }
+}
+
+void WaylandClipboardBackend::sourceSendCb(
+    void *data,
+    ext_data_control_source_v1 *dataSource,
+    const char *mimeType,
+    int32_t fd)
+{
+  auto *backend = static_cast<WaylandClipboardBackend *>(data);
+  auto *owner = backend->findSelection(dataSource);
+  if (owner == nullptr || owner->source == nullptr)
+  {
+    close(fd);
+    return;
+  }
+  auto target = gdk_atom_intern(mimeType, FALSE);
+  auto entry = find_if(owner->targets.begin(), owner->targets.end(),
+                       [target](const Target &candidate) { return candidate.target == target; });
+  if (entry == owner->targets.end())
+  {
+    close(fd);
+    return;
+  }
+
+  bool written = false;
+  owner->source->get(
+      entry->info,
+      [backend, fd, target, &written](const guchar *data, gsize length, bool text, GBytes *bytes)
+      {
+        written = true;
+        if (text && target == kGdkAtomString)
+        {
+          gsize latin1Length = 0;
+          auto *latin1 = g_convert_with_fallback(
+              reinterpret_cast<const gchar *>(data), length, "ISO-8859-1", "UTF-8", "?", nullptr, &latin1Length,
+              nullptr);
+          g_autoptr(GBytes) latin1Bytes = g_bytes_new_take(latin1, latin1 != nullptr ? latin1Length : 0);
+          backend->startWrite(fd, reinterpret_cast<const guchar *>(latin1), latin1Length, latin1Bytes);
+        }
+        else
+        {
+          // Our text is already UTF-8, which every other text target uses.
+          backend->startWrite(fd, data, length, bytes);
+        }
+      });
+  if (!written)
+  {
+    close(fd);
+  }
+}
+
+void WaylandClipboardBackend::sourceCancelledCb(void *data, ext_data_control_source_v1 *dataSource)
+{
+  auto *backend = static_cast<WaylandClipboardBackend *>(data);
+  auto *owner = backend->findSelection(dataSource);
+  if (owner != nullptr)
+  {
+    backend->release(*owner);
+  }
+}
+
+void WaylandClipboardBackend::startRead(int fd, GdkAtom target, bool text, ContentsCallback callback)
+{
+  auto *transfer = new Transfer{this, fd};
+  transfer->target = target;
+  transfer->text = text;
+  transfer->callback = move(callback);
+  g_unix_set_fd_nonblocking(fd, TRUE, nullptr);
+  transfer->watch = g_unix_fd_add(fd, static_cast<GIOCondition>(G_IO_IN | G_IO_ERR | G_IO_HUP), readCb, transfer);
+  transfer->timeout = g_timeout_add(kTransferTimeoutMs, transferTimeoutCb, transfer);
+  transfers.insert(transfer);
+}
+
+// Writes as much of data to the non-blocking fd as it takes. Returns how many
+// bytes were written, and stores 0 in error if that was all of them, EAGAIN
+// if the pipe is full, or why the write failed.
+//
+// A client that closes its end of a pipe before taking all of our data must
+// not kill the application, and the application's own handling of SIGPIPE
+// is left alone. The signal is blocked on this thread during the write, and
+// a SIGPIPE the write raised is taken back before it is unblocked.
+static gsize write_available(int fd, const guchar *data, gsize length, int &error)
+{
+  sigset_t pipeSignal;
+  sigset_t oldMask;
+  sigemptyset(&pipeSignal);
+  sigaddset(&pipeSignal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeSignal, &oldMask);
+  sigset_t pending;
+  sigpending(&pending);
+  bool alreadyPending = sigismember(&pending, SIGPIPE);
+
+  gsize offset = 0;
+  error = 0;
+  while (offset < length)
+  {
+    auto count = write(fd, data + offset, length - offset);
+    if (count > 0)
+    {
+      offset += count;
+    }
+    else if (count == 0 || errno != EINTR)
+    {
+      error = count == 0 ? EIO : errno;
+      break;
+    }
+  }
+
+  if (error == EPIPE && !alreadyPending)
+  {
+    const struct timespec noWait = {0, 0};
+    while (sigtimedwait(&pipeSignal, nullptr, &noWait) < 0 && errno == EINTR)
+    {
+    }
+  }
+  pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+  return offset;
+}
+
+// Most payloads fit in the pipe, so they are written right away. The rest is
+// written as the other client drains the pipe, straight from the source's
+// bytes.
+void WaylandClipboardBackend::startWrite(int fd, const guchar *data, gsize length, GBytes *bytes)
+{
+  g_unix_set_fd_nonblocking(fd, TRUE, nullptr);
+  int error;
+  auto offset = write_available(fd, data, length, error);
+  if (error != EAGAIN)
+  {
+    close(fd);
+    return;
+  }
+
+  auto *transfer = new Transfer{this, fd};
+  if (bytes != nullptr)
+  {
+    transfer->bytes = g_bytes_ref(bytes);
+    transfer->offset = offset;
+  }
+  else
+  {
+    // The data does not outlive the call, so what is left has to be copied.
+    transfer->bytes = g_bytes_new(data + offset, length - offset);
+  }
+  transfer->watch = g_unix_fd_add(fd, static_cast<GIOCondition>(G_IO_OUT | G_IO_ERR), writeCb, transfer);
+  transfer->timeout = g_timeout_add(kTransferTimeoutMs, transferTimeoutCb, transfer);
+  transfers.insert(transfer);
+}
+
+gboolean WaylandClipboardBackend::readCb(gint fd, GIOCondition condition, gpointer user_data)
+{
+  auto *transfer = static_cast<Transfer *>(user_data);
+  while (true)
+  {
+    auto length = transfer->data.size();
+    transfer->data.resize(length + kReadChunkLength);
+    auto count = read(fd, &transfer->data[length], kReadChunkLength);
+    transfer->data.resize(length + (count > 0 ? count : 0));
+    if (count > 0)
+    {
+      transfer->progressed = true;
+    }
+    else if (count < 0 && errno == EAGAIN)
+    {
+      return G_SOURCE_CONTINUE;
+    }
+    else if (count == 0 || errno != EINTR)
+    {
+      transfer->watch = 0;
+      transfer->backend->finishTransfer(transfer, count == 0);
+      return G_SOURCE_REMOVE;
+    }
+  }
+}
+
+gboolean WaylandClipboardBackend::writeCb(gint fd, GIOCondition condition, gpointer user_data)
+{
+  auto *transfer = static_cast<Transfer *>(user_data);
+  gsize length;
+  auto *data = static_cast<const guchar *>(g_bytes_get_data(transfer->bytes, &length));
+  int error;
+  auto count = write_available(fd, data + transfer->offset, length - transfer->offset, error);
+  transfer->offset += count;
+  if (count > 0)
+  {
+    transfer->progressed = true;
+  }
+  if (error == EAGAIN)
+  {
+    return G_SOURCE_CONTINUE;
+  }
+  // Done, or the other client closed its end.
+  transfer->watch = 0;
+  transfer->backend->finishTransfer(transfer, error == 0);
+  return G_SOURCE_REMOVE;
+}
+
+gboolean WaylandClipboardBackend::transferTimeoutCb(gpointer user_data)
+{
+  auto *transfer = static_cast<Transfer *>(user_data);
+  if (transfer->progressed)
+  {
+    transfer->progressed = false;
+    return G_SOURCE_CONTINUE;
+  }
+  transfer->timeout = 0;
+  transfer->backend->finishTransfer(transfer, false);
+  return G_SOURCE_REMOVE;
+}
+
+void WaylandClipboardBackend::finishTransfer(Transfer *transfer, bool completed)
+{
+  transfers.erase(transfer);
+  g_clear_handle_id(&transfer->watch, g_source_remove);
+  g_clear_handle_id(&transfer->timeout, g_source_remove);
+  close(transfer->fd);
+  g_clear_pointer(&transfer->bytes, g_bytes_unref);
+
+  unique_ptr<Transfer> finished(transfer);
+  if (!transfer->callback)
+  {
+    return;
+  }
+  if (!completed)
+  {
+    transfer->callback(nullptr, 0, nullptr);
+  }
+  else if (transfer->text && transfer->target == kGdkAtomString)
+  {
+    gsize length = 0;
+    auto *text = g_convert(
+        transfer->data.data(), transfer->data.size(), "UTF-8", "ISO-8859-1", nullptr, &length, nullptr);
+    g_autoptr(GBytes) bytes = text != nullptr ? g_bytes_new_take(text, length) : nullptr;
+    transfer->callback(reinterpret_cast<const guchar *>(text), length, bytes);
+  }
+  else
+  {
+    // The bytes read are handed over rather than copied.
+    auto *data = new string(move(transfer->data));
+    g_autoptr(GBytes) bytes = g_bytes_new_with_free_func(
+        data->data(), data->size(),
+        [](gpointer data)
+        {
+          delete static_cast<string *>(data);
+        },
+        data);
+    transfer->callback(reinterpret_cast<const guchar *>(data->data()), data->size(), bytes);
+  }
+}
+
+bool WaylandClipboardBackend::reportsOwnerChanges()
+{
+  return true;
+}
+
+void WaylandClipboardBackend::setOwnerChangeCallback(OwnerChangeCallback callback)
+{
+  ownerChangeCallback = move(callback);
+}
+
+void WaylandClipboardBackend::requestTargets(GdkAtom selection, TargetsCallback callback)
+{
+  auto &owner = getSelection(selection);
+  vector<GdkAtom> targets;
+  if (owner.source != nullptr)
+  {
+    for (auto &target : owner.targets)
+    {
+      targets.push_back(target.target);
+    }
+  }
+  else
+  {
+    targets = owner.offerTargets;
+  }
+  callback(targets.data(), targets.size());
+}
+
+void WaylandClipboardBackend::requestContents(
+    GdkAtom selection,
+    GdkAtom target,
+    bool text,
+    ContentsCallback callback)
+{
+  auto &owner = getSelection(selection);
+  if (owner.source != nullptr)
+  {
+    // Our own data needs no round trip through the compositor.
+    auto entry = find_if(owner.targets.begin(), owner.targets.end(),
+                         [target](const Target &candidate) { return candidate.target == target; });
+    bool written = false;
+    if (entry != owner.targets.end())
+    {
+      owner.source->get(
+          entry->info,
+          [&callback, &written](const guchar *data, gsize length, bool text, GBytes *bytes)
+          {
+            written = true;
+            callback(data, length, bytes);
+          });
+    }
+    if (!written)
+    {
+      callback(nullptr, 0, nullptr);
+    }
+    return;
+  }
+
+  if (owner.offer == nullptr ||
+      find(owner.offerTargets.begin(), owner.offerTargets.end(), target) == owner.offerTargets.end())
+  {
+    callback(nullptr, 0, nullptr);
+    return;
+  }
+  gint fds[2];
+  if (!g_unix_open_pipe(fds, FD_CLOEXEC, nullptr))
+  {
+    callback(nullptr, 0, nullptr);
+    return;
+  }
+  g_autofree gchar *mimeType = gdk_atom_name(target);
+  ext_data_control_offer_v1_receive(owner.offer, mimeType, fds[1]);
+  flush();
+  // The compositor has its own copy of the write end now.
+  close(fds[1]);
+  startRead(fds[0], target, text, move(callback));
+}
+
+void WaylandClipboardBackend::setData(
+    GdkAtom selection,
+    const GtkTargetEntry *targets,
+    gint numTargets,
+    ClipboardSource *source)
+{
+  auto &owner = getSelection(selection);
+  auto *previous = owner.source;
+  owner.source = nullptr;
+  g_clear_pointer(&owner.dataSource, ext_data_control_source_v1_destroy);
+  if (previous != nullptr && previous != source)
+  {
+    previous->clear();
+  }
+
+  owner.source = source;
+  owner.targets.clear();
+  for (gint i = 0; i < numTargets; i++)
+  {
+    owner.targets.push_back({gdk_atom_intern(targets[i].target, FALSE), targets[i].info});
+  }
+  if (device == nullptr)
+  {
+    return;
+  }
+
+  static const ext_data_control_source_v1_listener sourceListener = {
+      sourceSendCb,
+      sourceCancelledCb,
+  };
+  owner.dataSource = ext_data_control_manager_v1_create_data_source(manager);
+  ext_data_control_source_v1_add_listener(owner.dataSource, &sourceListener, this);
+  for (gint i = 0; i < numTargets; i++)
+  {
+    ext_data_control_source_v1_offer(owner.dataSource, targets[i].target);
+  }
+  publish(selection, owner.dataSource);
+}
+
+void WaylandClipboardBackend::clear(GdkAtom selection)
+{
+  auto &owner = getSelection(selection);
+  if (device != nullptr && owner.dataSource != nullptr)
+  {
+    publish(selection, nullptr);
+  }
+  release(owner);
+}
+
+void WaylandClipboardBackend::empty(GdkAtom selection)
+{
+  if (device != nullptr)
+  {
+    publish(selection, nullptr);
+  }
+  release(getSelection(selection));
+}
+
+// Wayland has no clipboard manager to hand data to, see the class comment.
+void WaylandClipboardBackend::setCanStore(const GtkTargetEntry *targets, gint numTargets) {}
+
+void WaylandClipboardBackend::store(const vector<GdkAtom> &targets, StoreCallback callback)
+{
+  callback(kStoreOutcomeFailed);
+}
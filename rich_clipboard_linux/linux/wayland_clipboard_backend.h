@@ -0,0 +1,136 @@
+#ifndef RICH_CLIPBOARD_LINUX_WAYLAND_CLIPBOARD_BACKEND_H_
+#define RICH_CLIPBOARD_LINUX_WAYLAND_CLIPBOARD_BACKEND_H_
+
+#include "clipboard_backend.h"
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+struct wl_display;
+struct wl_registry;
+struct wl_seat;
+struct ext_data_control_manager_v1;
+struct ext_data_control_device_v1;
+struct ext_data_control_source_v1;
+struct ext_data_control_offer_v1;
+
+// The clipboard of a Wayland compositor, through the ext-data-control
+// protocol that clipboard managers use.
+//
+// GtkClipboard goes through XWayland when GDK runs on X11, and under Wayland
+// it can only read the clipboard while a window of the application has
+// keyboard focus. This backend opens its own connection to the compositor,
+// so it reads and watches the clipboard with or without focus, whichever
+// backend GDK uses, and each transfer is a single pipe to the other client.
+//
+// Wayland has no clipboard manager handoff: managers copy the clipboard
+// themselves through the same protocol, so store always fails.
+class WaylandClipboardBackend : public ClipboardBackend
+{
+private:
+  struct Target
+  {
+    GdkAtom target;
+    guint info;
+  };
+  // What the compositor reports on a selection, and the data we put there.
+  struct Selection
+  {
+    // The current data of the selection, or null if it is empty. This is
+    // also set for our own data, which the compositor offers back to us.
+    ext_data_control_offer_v1 *offer = nullptr;
+    std::vector<GdkAtom> offerTargets;
+    // Our data, while we own the selection.
+    ext_data_control_source_v1 *dataSource = nullptr;
+    ClipboardSource *source = nullptr;
+    std::vector<Target> targets;
+  };
+  // A pipe to or from another client, defined in the source file.
+  struct Transfer;
+
+  wl_display *display = nullptr;
+  wl_registry *registry = nullptr;
+  wl_seat *seat = nullptr;
+  ext_data_control_manager_v1 *manager = nullptr;
+  ext_data_control_device_v1 *device = nullptr;
+  guint displayWatch = 0;
+
+  Selection clipboard;
+  Selection primary;
+  // Offers whose types are still being announced, until the selection event
+  // that names them.
+  std::map<ext_data_control_offer_v1 *, std::vector<GdkAtom>> newOffers;
+  std::set<Transfer *> transfers;
+  OwnerChangeCallback ownerChangeCallback;
+
+  Selection &getSelection(GdkAtom selection);
+  Selection *findSelection(ext_data_control_source_v1 *dataSource);
+  void setOffer(Selection &selection, ext_data_control_offer_v1 *offer);
+  // Makes dataSource the data of selection, or empties it if it is null.
+  void publish(GdkAtom selection, ext_data_control_source_v1 *dataSource);
+  // Forgets our data on selection, and clears its source.
+  void release(Selection &selection);
+  // Forgets both selections and the device, which leaves them empty.
+  void closeDevice();
+  void disconnect();
+  void flush();
+
+  void startRead(int fd, GdkAtom target, bool text, ContentsCallback callback);
+  // Writes data to fd, keeping a reference to bytes, if it holds data, for
+  // what the pipe cannot take right away.
+  void startWrite(int fd, const guchar *data, gsize length, GBytes *bytes);
+  void finishTransfer(Transfer *transfer, bool completed);
+
+  static gboolean displayCb(gint fd, GIOCondition condition, gpointer user_data);
+  static gboolean readCb(gint fd, GIOCondition condition, gpointer user_data);
+  static gboolean writeCb(gint fd, GIOCondition condition, gpointer user_data);
+  static gboolean transferTimeoutCb(gpointer user_data);
+
+  static void registryGlobalCb(
+      void *data,
+      wl_registry *registry,
+      uint32_t name,
+      const char *interface,
+      uint32_t version);
+  static void registryGlobalRemoveCb(void *data, wl_registry *registry, uint32_t name);
+  static void deviceDataOfferCb(void *data, ext_data_control_device_v1 *device, ext_data_control_offer_v1 *offer);
+  static void deviceSelectionCb(void *data, ext_data_control_device_v1 *device, ext_data_control_offer_v1 *offer);
+  static void deviceFinishedCb(void *data, ext_data_control_device_v1 *device);
+  static void devicePrimarySelectionCb(
+      void *data,
+      ext_data_control_device_v1 *device,
+      ext_data_control_offer_v1 *offer);
+  static void offerOfferCb(void *data, ext_data_control_offer_v1 *offer, const char *mimeType);
+  static void sourceSendCb(void *data, ext_data_control_source_v1 *dataSource, const char *mimeType, int32_t fd);
+  static void sourceCancelledCb(void *data, ext_data_control_source_v1 *dataSource);
+
+public:
+  // Connects to the compositor named displayName, or to the one in
+  // WAYLAND_DISPLAY if it is null. Check isConnected before using it.
+  explicit WaylandClipboardBackend(const char *displayName = nullptr);
+  ~WaylandClipboardBackend() override;
+  WaylandClipboardBackend(const WaylandClipboardBackend &) = delete;
+  WaylandClipboardBackend &operator=(const WaylandClipboardBackend &) = delete;
+
+  // Whether the compositor supports ext-data-control and the connection to
+  // it is still up.
+  bool isConnected();
+
+  bool reportsOwnerChanges() override;
+  void setOwnerChangeCallback(OwnerChangeCallback callback) override;
+  void requestTargets(GdkAtom selection, TargetsCallback callback) override;
+  void requestContents(GdkAtom selection, GdkAtom target, bool text, ContentsCallback callback) override;
+  void setData(
+      GdkAtom selection,
+      const GtkTargetEntry *targets,
+      gint numTargets,
+      ClipboardSource *source) override;
+  void clear(GdkAtom selection) override;
+  void empty(GdkAtom selection) override;
+  void setCanStore(const GtkTargetEntry *targets, gint numTargets) override;
+  void store(const std::vector<GdkAtom> &targets, StoreCallback callback) override;
+};
+
+#endif  // RICH_CLIPBOARD_LINUX_WAYLAND_CLIPBOARD_BACKEND_H_
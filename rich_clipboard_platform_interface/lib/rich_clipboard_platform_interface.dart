@@ -1,16 +1,35 @@
+import 'dart:async';
+import 'dart:typed_data';
+
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 
 import 'src/fallback_rich_clipboard.dart';
+import 'src/rich_clipboard_change.dart';
 import 'src/rich_clipboard_data.dart';
+import 'src/rich_clipboard_data_stream.dart';
+import 'src/rich_clipboard_history_item.dart';
+import 'src/rich_clipboard_image.dart';
 
 export 'src/method_channel_rich_clipboard.dart' show MethodChannelRichClipboard;
+export 'src/rich_clipboard_change.dart' show RichClipboardChange;
 export 'src/rich_clipboard_data.dart' show RichClipboardData;
+export 'src/rich_clipboard_data_stream.dart' show RichClipboardDataStream;
+export 'src/rich_clipboard_history_item.dart' show RichClipboardHistoryItem;
+export 'src/rich_clipboard_image.dart' show RichClipboardImage;
+
+/// Renders clipboard data of the given MIME type on demand.
+///
+/// Returns `null` if the data is not available after all.
+typedef RichClipboardDataProvider = FutureOr<String?> Function(String mimeType);
 
 abstract class RichClipboardPlatform extends PlatformInterface {
   RichClipboardPlatform() : super(token: _token);
 
   static final Object _token = Object();
 
+  /// The number of bytes [openDataStream] reads at a time by default.
+  static const int defaultChunkSize = 1 << 20;
+
   static RichClipboardPlatform _instance = FallbackRichClipboard();
 
   static RichClipboardPlatform get instance => _instance;
@@ -30,11 +49,58 @@ abstract class RichClipboardPlatform extends PlatformInterface {
   /// Returns a future which completes to a [RichClipboardData].
   Future<RichClipboardData> getData();
 
+  /// Retrieves only the given MIME [types] from the system clipboard.
+  ///
+  /// [types] may contain `text/plain` and `text/html`. Fields of the returned
+  /// [RichClipboardData] for types that were not requested are `null`. Some
+  /// platforms skip the transfers for the other types entirely, which makes
+  /// reading just the text of a large rich copy much cheaper.
+  Future<RichClipboardData> getDataOfTypes(List<String> types) async {
+    final data = await getData();
+    return RichClipboardData(
+      text: types.contains('text/plain') ? data.text : null,
+      html: types.contains('text/html') ? data.html : null,
+    );
+  }
+
   /// Stores the provided data in the system clipboard.
   ///
   /// To clear the clipboard pass an empty [RichClipboardData].
   Future<void> setData(RichClipboardData data);
 
+  /// Stores [html] in the system clipboard, along with `text/plain` that the
+  /// platform flattens from it.
+  ///
+  /// The plain text is only built when another application asks for it, so
+  /// pastes that take the HTML never pay for it.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> setHtmlData(String html) {
+    throw UnimplementedError('setHtmlData() has not been implemented.');
+  }
+
+  /// Retrieves the primary selection, which holds whatever text is currently
+  /// selected in any application and is pasted with a middle click.
+  ///
+  /// Pass [types] to only read some of `text/plain` and `text/html`.
+  ///
+  /// Currently only supported on Linux.
+  Future<RichClipboardData> getPrimaryData({List<String>? types}) {
+    throw UnimplementedError('getPrimaryData() has not been implemented.');
+  }
+
+  /// Makes the provided data the primary selection.
+  ///
+  /// This is meant to be called whenever the selection changes, including
+  /// on every step of a selection drag. Updates are coalesced, so only the
+  /// latest selection is published, and at most a few times per second. To
+  /// give up the selection pass an empty [RichClipboardData].
+  ///
+  /// Currently only supported on Linux.
+  Future<void> setPrimaryData(RichClipboardData data) {
+    throw UnimplementedError('setPrimaryData() has not been implemented.');
+  }
+
   /// Retrieves a list of strings representing the data types available in the
   /// system clipboard.
   ///
@@ -45,4 +111,275 @@ abstract class RichClipboardPlatform extends PlatformInterface {
   /// available in the system clipboard then the future will resolve to an empty
   /// list.
   Future<List<String>> getAvailableTypes();
+
+  /// Checks which of the given MIME [types] the system clipboard can provide,
+  /// without reading any of them.
+  ///
+  /// The returned list holds one entry per type in [types], in order.
+  /// On Linux, `text/plain` is available when any text type is. At most 64
+  /// types may be checked at once.
+  ///
+  /// Some platforms answer this from the types they already know, which is
+  /// much cheaper than calling [getAvailableTypes].
+  Future<List<bool>> hasTypes(List<String> types) async {
+    final available = await getAvailableTypes();
+    return [for (final type in types) available.contains(type)];
+  }
+
+  /// Retrieves the raw bytes of the requested data types from the system
+  /// clipboard.
+  ///
+  /// [types] may contain any of the types reported by [getAvailableTypes], as
+  /// well as `text/plain`, which is returned as UTF-8. Types that are not
+  /// available are left out of the returned map. No transcoding is done, so
+  /// this is suitable for images and application specific formats.
+  ///
+  /// Currently only supported on Linux.
+  Future<Map<String, Uint8List>> getBinaryData(List<String> types) {
+    throw UnimplementedError('getBinaryData() has not been implemented.');
+  }
+
+  /// Stores the provided map of data types to raw bytes in the system
+  /// clipboard.
+  ///
+  /// `text/plain` must be UTF-8 and is offered under all of the platform's
+  /// text types. Every other key is offered as is.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> setBinaryData(Map<String, Uint8List> data) {
+    throw UnimplementedError('setBinaryData() has not been implemented.');
+  }
+
+  /// Stores the contents of files in the system clipboard, given as a map of
+  /// data types to file paths.
+  ///
+  /// The platform maps each file into memory rather than reading it, and
+  /// serves pastes straight from the mapping, so neither Dart nor the
+  /// platform holds a copy. This is meant for exports too large to hold
+  /// comfortably as one [String]. The types are offered like those of
+  /// [setBinaryData], so `text/plain` must be UTF-8.
+  ///
+  /// The files must not be truncated or rewritten while the clipboard holds
+  /// them. Write each export to a new file and delete it once the clipboard
+  /// changes. Completes with an error if a file cannot be opened.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> setFileData(Map<String, String> files) {
+    throw UnimplementedError('setFileData() has not been implemented.');
+  }
+
+  /// Retrieves the image in the system clipboard, scaled down to fit
+  /// [maxWidth] and [maxHeight] and encoded as [type].
+  ///
+  /// The platform decodes, scales and encodes the image off the UI thread,
+  /// so only the result crosses into Dart. Images are never scaled up, and
+  /// without limits they keep their size. Without [type] the image keeps its
+  /// encoding, and an image that needs neither scaling nor re-encoding is
+  /// returned as it is. [quality] from 0 to 100 applies to `image/jpeg`.
+  ///
+  /// Returns a future that completes to `null` if the clipboard holds no
+  /// image the platform can decode.
+  ///
+  /// Currently only supported on Linux.
+  Future<RichClipboardImage?> getImage({
+    int? maxWidth,
+    int? maxHeight,
+    String? type,
+    int? quality,
+  }) {
+    throw UnimplementedError('getImage() has not been implemented.');
+  }
+
+  /// Stores the image in [bytes], encoded as [type], in the system clipboard.
+  ///
+  /// The image is also offered in each of [encodings] the platform can
+  /// encode. Those are only produced when another application pastes them.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> setImage(
+    Uint8List bytes, {
+    String type = 'image/png',
+    List<String> encodings = defaultImageEncodings,
+  }) {
+    throw UnimplementedError('setImage() has not been implemented.');
+  }
+
+  /// Reads a single data type from the system clipboard in chunks of at most
+  /// [chunkSize] bytes.
+  ///
+  /// This is meant for payloads too large to hold comfortably as one
+  /// [String], such as a huge log pasted straight to disk. [type] is any of
+  /// the types accepted by [getBinaryData], and the bytes are the same.
+  ///
+  /// Returns a future that completes to `null` if [type] is not available.
+  /// The platform keeps the payload until the stream is done or cancelled,
+  /// but drops it when the stream sits paused for a minute or when too many
+  /// streams are open at once. A dropped stream ends with an error.
+  ///
+  /// Currently only supported on Linux.
+  Future<RichClipboardDataStream?> openDataStream(
+    String type, {
+    int chunkSize = defaultChunkSize,
+  }) {
+    throw UnimplementedError('openDataStream() has not been implemented.');
+  }
+
+  /// Waits for the system's clipboard manager to take a copy of the data this
+  /// application last stored, so that it stays available after the
+  /// application exits.
+  ///
+  /// Storing data already starts the handoff in the background, so
+  /// [setData] does not wait for it. This future reports how it went, or
+  /// retries it if it failed before.
+  ///
+  /// Returns a future that completes to `true` if the manager took the data,
+  /// and to `false` if there is no manager, it refused, it timed out, or the
+  /// clipboard holds promised data.
+  ///
+  /// Currently only supported on Linux.
+  Future<bool> storeClipboard() {
+    throw UnimplementedError('storeClipboard() has not been implemented.');
+  }
+
+  /// Performance counters of the platform's clipboard handling since it
+  /// started or since [resetStats], meant to be forwarded to telemetry.
+  ///
+  /// On Linux the map holds:
+  ///
+  /// * `since`: when counting started, in milliseconds since the epoch.
+  /// * `methods`: for each method name, the number of `calls`, their
+  ///   `totalUs` and `maxUs` latency in microseconds, and a `histogram` of
+  ///   call counts per latency bucket.
+  /// * `latencyBucketsUs`: the upper bound of each histogram bucket. The
+  ///   histogram has one more bucket, for slower calls.
+  /// * `types`: for each MIME type, the `bytesRead` from other applications,
+  ///   the `bytesWritten` by this one, and the `pastesServed` to other
+  ///   applications with the `bytesServed` by them.
+  /// * `pastesServed`: the total number of pastes served.
+  /// * `storesSucceeded`, `storesFailed` and `storesTimedOut`: the outcomes
+  ///   of handing data to the clipboard manager.
+  /// * `writesDeduplicated`: the [setData] calls that were skipped because
+  ///   this application already held the same data.
+  /// * `peakOwnedBytes`: the most data this application held on the
+  ///   clipboard at once.
+  ///
+  /// Currently only supported on Linux.
+  Future<Map<String, Object?>> getStats() {
+    throw UnimplementedError('getStats() has not been implemented.');
+  }
+
+  /// Starts counting the values [getStats] reports from zero.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> resetStats() {
+    throw UnimplementedError('resetStats() has not been implemented.');
+  }
+
+  /// Returns a fingerprint of the system clipboard's content, computed
+  /// without transferring it.
+  ///
+  /// The fingerprint covers the clipboard's `text/plain` and `text/html`,
+  /// taken from the data this application put on the clipboard while it
+  /// still holds it, or else from what it has already read from the current
+  /// owner. The same content has the same fingerprint either way. If an
+  /// offered type has not been read yet, the future completes to `null`.
+  /// Comparing fingerprints tells whether the content changed since it was
+  /// last read, without reading it again.
+  ///
+  /// Currently only supported on Linux.
+  Future<String?> getContentFingerprint() {
+    throw UnimplementedError(
+      'getContentFingerprint() has not been implemented.',
+    );
+  }
+
+  /// The encodings [setImage] offers by default.
+  static const List<String> defaultImageEncodings = [
+    'image/png',
+    'image/jpeg',
+    'image/bmp',
+  ];
+
+  /// The default byte budget of [enableHistory].
+  static const int defaultHistoryMaxBytes = 16 << 20;
+
+  /// Starts keeping a history of the system clipboard's text and HTML in the
+  /// platform, captured on every change whether or not [onChanged] has
+  /// listeners.
+  ///
+  /// The history is held in native memory, compressed, and takes at most
+  /// [maxBytes]. Once it is full, the oldest entries are dropped. Calling
+  /// this again while the history is enabled changes its budget.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> enableHistory({int maxBytes = defaultHistoryMaxBytes}) {
+    throw UnimplementedError('enableHistory() has not been implemented.');
+  }
+
+  /// Stops keeping the history and drops its entries.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> disableHistory() {
+    throw UnimplementedError('disableHistory() has not been implemented.');
+  }
+
+  /// Drops the entries of the history, which stays enabled.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> clearHistory() {
+    throw UnimplementedError('clearHistory() has not been implemented.');
+  }
+
+  /// Lists up to [limit] entries of the history, newest first.
+  ///
+  /// Only metadata is listed. To page through the history, pass the id of
+  /// the last item of a page as [before] to list the entries older than it.
+  /// Copying the same content again moves its entry to the top under a new
+  /// id. Completes to an empty list if the history is not enabled.
+  ///
+  /// Currently only supported on Linux.
+  Future<List<RichClipboardHistoryItem>> getHistory({
+    int? before,
+    int limit = 50,
+  }) {
+    throw UnimplementedError('getHistory() has not been implemented.');
+  }
+
+  /// Retrieves the data of the history entry with [id].
+  ///
+  /// Completes to `null` if the entry has been dropped from the history.
+  ///
+  /// Currently only supported on Linux.
+  Future<RichClipboardData?> getHistoryEntry(int id) {
+    throw UnimplementedError('getHistoryEntry() has not been implemented.');
+  }
+
+  /// A stream of changes to the system clipboard.
+  ///
+  /// The platform only watches the clipboard while the stream has listeners,
+  /// and reports a change only when the clipboard's owner actually changes.
+  ///
+  /// Currently only supported on Linux.
+  Stream<RichClipboardChange> get onChanged {
+    throw UnimplementedError('onChanged has not been implemented.');
+  }
+
+  /// Stores data in the system clipboard that is only rendered when it is
+  /// requested.
+  ///
+  /// The clipboard advertises [types] right away, and [provider] is called
+  /// the first time another application (or [getData]) asks for one of them.
+  /// Formats that are never pasted are never rendered. Each rendered format is
+  /// kept until the clipboard changes, at which point [provider] is released.
+  ///
+  /// Promised data is not handed to a clipboard manager, so it does not
+  /// outlive the application.
+  ///
+  /// Currently only supported on Linux.
+  Future<void> setPromisedData(
+    List<String> types,
+    RichClipboardDataProvider provider,
+  ) {
+    throw UnimplementedError('setPromisedData() has not been implemented.');
+  }
 }
@@ -1,8 +1,14 @@
+import 'dart:async';
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 
 import '../rich_clipboard_platform_interface.dart';
 
 const MethodChannel _channel = MethodChannel('com.bringingfire.rich_clipboard');
+const EventChannel _changesChannel =
+    EventChannel('com.bringingfire.rich_clipboard/changes');
 
 /// A default [RichClipboardPlatform] implementation backed by a platform
 /// channel.
@@ -19,6 +25,19 @@ class MethodChannelRichClipboard extends RichClipboardPlatform {
     return result ?? [];
   }
 
+  @override
+  Future<List<bool>> hasTypes(List<String> types) async {
+    final int mask;
+    try {
+      // Bit i of the result is set if types[i] is available.
+      mask = await _channel.invokeMethod<int>('hasTypes', types) ?? 0;
+    } on MissingPluginException {
+      // Only Linux answers hasTypes natively.
+      return super.hasTypes(types);
+    }
+    return List.generate(types.length, (i) => (mask >> i) & 1 == 1);
+  }
+
   @override
   Future<RichClipboardData> getData() async {
     final data = await _channel.invokeMapMethod<String, String?>('getData');
@@ -29,8 +48,278 @@ class MethodChannelRichClipboard extends RichClipboardPlatform {
     return RichClipboardData.fromMap(data);
   }
 
+  @override
+  Future<RichClipboardData> getDataOfTypes(List<String> types) async {
+    final data =
+        await _channel.invokeMapMethod<String, String?>('getData', types);
+    if (data == null) {
+      return const RichClipboardData();
+    }
+
+    // Platforms that ignore the requested types still return all of them.
+    data.removeWhere((type, _) => !types.contains(type));
+    return RichClipboardData.fromMap(data);
+  }
+
   @override
   Future<void> setData(RichClipboardData data) async {
+    _promiseProvider = null;
     await _channel.invokeMethod('setData', data.toMap());
   }
+
+  @override
+  Future<void> setHtmlData(String html) async {
+    // Other platforms would store the HTML without the derived plain text.
+    if (defaultTargetPlatform != TargetPlatform.linux) {
+      return super.setHtmlData(html);
+    }
+    _promiseProvider = null;
+    await _channel.invokeMethod('setData', {
+      'text/html': html,
+      'derivePlainText': true,
+    });
+  }
+
+  @override
+  Future<RichClipboardData> getPrimaryData({List<String>? types}) async {
+    final data = await _channel.invokeMapMethod<String, String?>(
+      'getPrimaryData',
+      types,
+    );
+    if (data == null) {
+      return const RichClipboardData();
+    }
+
+    return RichClipboardData.fromMap(data);
+  }
+
+  @override
+  Future<void> setPrimaryData(RichClipboardData data) async {
+    await _channel.invokeMethod('setPrimaryData', data.toMap());
+  }
+
+  @override
+  Future<Map<String, Uint8List>> getBinaryData(List<String> types) async {
+    final data = await _channel
+        .invokeMapMethod<String, Uint8List>('getBinaryData', types);
+    return data ?? {};
+  }
+
+  @override
+  Future<void> setBinaryData(Map<String, Uint8List> data) async {
+    _promiseProvider = null;
+    await _channel.invokeMethod('setBinaryData', data);
+  }
+
+  @override
+  Future<void> setFileData(Map<String, String> files) async {
+    _promiseProvider = null;
+    await _channel.invokeMethod('setFileData', files);
+  }
+
+  @override
+  Future<RichClipboardImage?> getImage({
+    int? maxWidth,
+    int? maxHeight,
+    String? type,
+    int? quality,
+  }) async {
+    final image = await _channel.invokeMapMethod<Object?, Object?>(
+      'getImage',
+      {
+        'maxWidth': maxWidth,
+        'maxHeight': maxHeight,
+        'type': type,
+        'quality': quality,
+      },
+    );
+    return image == null ? null : RichClipboardImage.fromMap(image);
+  }
+
+  @override
+  Future<void> setImage(
+    Uint8List bytes, {
+    String type = 'image/png',
+    List<String> encodings = RichClipboardPlatform.defaultImageEncodings,
+  }) async {
+    _promiseProvider = null;
+    await _channel.invokeMethod('setImage', {
+      'data': bytes,
+      'type': type,
+      'types': encodings,
+    });
+  }
+
+  @override
+  Future<RichClipboardDataStream?> openDataStream(
+    String type, {
+    int chunkSize = RichClipboardPlatform.defaultChunkSize,
+  }) async {
+    final stream =
+        await _channel.invokeMapMethod<String, int>('openDataStream', type);
+    if (stream == null) {
+      return null;
+    }
+
+    final id = stream['id']!;
+    final length = stream['length']!;
+    var offset = 0;
+    var reading = false;
+    var closed = false;
+    late final StreamController<Uint8List> controller;
+
+    Future<void> close() async {
+      if (closed) {
+        return;
+      }
+      closed = true;
+      await _channel.invokeMethod('closeDataStream', id);
+    }
+
+    Future<void> pump() async {
+      if (reading) {
+        return;
+      }
+      reading = true;
+      try {
+        while (!closed && !controller.isPaused && offset < length) {
+          final chunk = await _channel.invokeMethod<Uint8List>(
+            'readDataStream',
+            {'id': id, 'offset': offset, 'length': chunkSize},
+          );
+          if (chunk == null || chunk.isEmpty) {
+            break;
+          }
+          offset += chunk.length;
+          if (!closed) {
+            controller.add(chunk);
+          }
+        }
+        if (!closed && !controller.isPaused) {
+          await close();
+          await controller.close();
+        }
+      } catch (error, stackTrace) {
+        if (!closed) {
+          controller.addError(error, stackTrace);
+          await close();
+          await controller.close();
+        }
+      } finally {
+        reading = false;
+      }
+    }
+
+    controller = StreamController<Uint8List>(
+      onListen: pump,
+      onResume: pump,
+      onCancel: close,
+    );
+    return RichClipboardDataStream(controller.stream, length: length);
+  }
+
+  @override
+  Future<void> setPromisedData(
+    List<String> types,
+    RichClipboardDataProvider provider,
+  ) async {
+    _channel.setMethodCallHandler(_handleMethodCall);
+    _promiseProvider = provider;
+    await _channel.invokeMethod('setPromisedData', {
+      'id': ++_promiseId,
+      'types': types,
+    });
+  }
+
+  RichClipboardDataProvider? _promiseProvider;
+  int _promiseId = 0;
+
+  Future<Object?> _handleMethodCall(MethodCall call) async {
+    final args = call.arguments as Map<Object?, Object?>;
+    final isCurrentPromise = args['id'] == _promiseId;
+    switch (call.method) {
+      case 'providePromisedData':
+        final provider = _promiseProvider;
+        if (!isCurrentPromise || provider == null) {
+          return null;
+        }
+        return await provider(args['type'] as String);
+      case 'releasePromisedData':
+        if (isCurrentPromise) {
+          _promiseProvider = null;
+        }
+        return null;
+      default:
+        throw MissingPluginException();
+    }
+  }
+
+  @override
+  Future<bool> storeClipboard() async {
+    final stored = await _channel.invokeMethod<bool>('storeClipboard');
+    return stored ?? false;
+  }
+
+  @override
+  Future<Map<String, Object?>> getStats() async {
+    final stats = await _channel.invokeMapMethod<String, Object?>('getStats');
+    return stats ?? {};
+  }
+
+  @override
+  Future<void> resetStats() async {
+    await _channel.invokeMethod<void>('resetStats');
+  }
+
+  @override
+  Future<String?> getContentFingerprint() async =>
+      _channel.invokeMethod<String>('getContentFingerprint');
+
+  @override
+  Future<void> enableHistory({
+    int maxBytes = RichClipboardPlatform.defaultHistoryMaxBytes,
+  }) async {
+    await _channel.invokeMethod<void>('enableHistory', {'maxBytes': maxBytes});
+  }
+
+  @override
+  Future<void> disableHistory() async {
+    await _channel.invokeMethod<void>('disableHistory');
+  }
+
+  @override
+  Future<void> clearHistory() async {
+    await _channel.invokeMethod<void>('clearHistory');
+  }
+
+  @override
+  Future<List<RichClipboardHistoryItem>> getHistory({
+    int? before,
+    int limit = 50,
+  }) async {
+    final items = await _channel.invokeListMethod<Map<Object?, Object?>>(
+      'getHistory',
+      {'before': before, 'limit': limit},
+    );
+    return items?.map(RichClipboardHistoryItem.fromMap).toList() ?? [];
+  }
+
+  @override
+  Future<RichClipboardData?> getHistoryEntry(int id) async {
+    final data = await _channel.invokeMapMethod<String, String?>(
+      'getHistoryEntry',
+      id,
+    );
+    return data == null ? null : RichClipboardData.fromMap(data);
+  }
+
+  @override
+  Stream<RichClipboardChange> get onChanged {
+    return _onChanged ??= _changesChannel
+        .receiveBroadcastStream()
+        .cast<Map<Object?, Object?>>()
+        .map(RichClipboardChange.fromMap);
+  }
+
+  Stream<RichClipboardChange>? _onChanged;
 }
@@ -0,0 +1,47 @@
+import 'package:flutter/foundation.dart';
+
+/// A change of the system clipboard's contents.
+@immutable
+class RichClipboardChange {
+  const RichClipboardChange({
+    required this.sequence,
+    required this.timestamp,
+    required this.types,
+  });
+  RichClipboardChange.fromMap(Map<Object?, Object?> map)
+      : this(
+          sequence: map['sequence'] as int,
+          timestamp:
+              DateTime.fromMillisecondsSinceEpoch(map['timestamp'] as int),
+          types: (map['types'] as List<Object?>).cast<String>(),
+        );
+
+  /// Increases by one for every change reported by the platform.
+  ///
+  /// A gap between two received changes means intermediate changes were
+  /// coalesced.
+  final int sequence;
+
+  /// When the platform observed the change.
+  final DateTime timestamp;
+
+  /// The data types available in the clipboard after the change, in the same
+  /// platform dependent format as [RichClipboardPlatform.getAvailableTypes].
+  final List<String> types;
+
+  @override
+  String toString() =>
+      'RichClipboardChange{ sequence: $sequence, timestamp: $timestamp, types: $types }';
+
+  @override
+  operator ==(Object other) =>
+      identical(this, other) ||
+      other is RichClipboardChange &&
+          runtimeType == other.runtimeType &&
+          sequence == other.sequence &&
+          timestamp == other.timestamp &&
+          listEquals(types, other.types);
+
+  @override
+  int get hashCode => Object.hash(sequence, timestamp, Object.hashAll(types));
+}
@@ -0,0 +1,17 @@
+import 'dart:async';
+import 'dart:typed_data';
+
+/// A single clipboard format read in chunks.
+///
+/// The total [length] in bytes is known before the first chunk arrives. The
+/// next chunk is only requested once the previous one has been delivered, so
+/// pausing the subscription pauses the transfer and memory stays bounded by
+/// the chunk size.
+class RichClipboardDataStream extends StreamView<Uint8List> {
+  /// Creates a stream of [length] bytes delivered by [stream].
+  RichClipboardDataStream(Stream<Uint8List> stream, {required this.length})
+      : super(stream);
+
+  /// The total number of bytes the stream delivers.
+  final int length;
+}
@@ -0,0 +1,59 @@
+import 'package:flutter/foundation.dart';
+
+/// The metadata of an entry in the platform's clipboard history.
+///
+/// The data itself is fetched with
+/// [RichClipboardPlatform.getHistoryEntry].
+@immutable
+class RichClipboardHistoryItem {
+  const RichClipboardHistoryItem({
+    required this.id,
+    required this.timestamp,
+    required this.types,
+    this.preview,
+  });
+  RichClipboardHistoryItem.fromMap(Map<Object?, Object?> map)
+      : this(
+          id: map['id'] as int,
+          timestamp:
+              DateTime.fromMillisecondsSinceEpoch(map['timestamp'] as int),
+          types: (map['types'] as Map<Object?, Object?>).cast<String, int>(),
+          preview: map['preview'] as String?,
+        );
+
+  /// Identifies the entry. Newer entries have larger ids.
+  final int id;
+
+  /// When the entry was captured.
+  final DateTime timestamp;
+
+  /// The MIME types in the entry, with the length of each in bytes.
+  final Map<String, int> types;
+
+  /// The start of the entry's plain text, if it has any.
+  final String? preview;
+
+  @override
+  String toString() =>
+      'RichClipboardHistoryItem{ id: $id, timestamp: $timestamp, types: $types, preview: $preview }';
+
+  @override
+  operator ==(Object other) =>
+      identical(this, other) ||
+      other is RichClipboardHistoryItem &&
+          runtimeType == other.runtimeType &&
+          id == other.id &&
+          timestamp == other.timestamp &&
+          mapEquals(types, other.types) &&
+          preview == other.preview;
+
+  @override
+  int get hashCode => Object.hash(
+        id,
+        timestamp,
+        Object.hashAllUnordered(
+          types.entries.map((entry) => Object.hash(entry.key, entry.value)),
+        ),
+        preview,
+      );
+}
@@ -0,0 +1,48 @@
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
+
+/// An image read from the system clipboard.
+@immutable
+class RichClipboardImage {
+  const RichClipboardImage({
+    required this.type,
+    required this.width,
+    required this.height,
+    required this.bytes,
+  });
+  RichClipboardImage.fromMap(Map<Object?, Object?> map)
+      : this(
+          type: map['type'] as String,
+          width: map['width'] as int,
+          height: map['height'] as int,
+          bytes: map['data'] as Uint8List,
+        );
+
+  /// The MIME type [bytes] are encoded in, like `image/png`.
+  final String type;
+
+  /// The size of the image in pixels.
+  final int width;
+  final int height;
+
+  /// The encoded image.
+  final Uint8List bytes;
+
+  @override
+  String toString() =>
+      'RichClipboardImage{ type: $type, width: $width, height: $height, bytes: ${bytes.length} }';
+
+  @override
+  operator ==(Object other) =>
+      identical(this, other) ||
+      other is RichClipboardImage &&
+          runtimeType == other.runtimeType &&
+          type == other.type &&
+          width == other.width &&
+          height == other.height &&
+          listEquals(bytes, other.bytes);
+
+  @override
+  int get hashCode => Object.hash(type, width, height, bytes.length);
+}
@@ -0,0 +1,102 @@
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:rich_clipboard_platform_interface/rich_clipboard_platform_interface.dart';
+
+const channel = MethodChannel('com.bringingfire.rich_clipboard');
+
+void main() {
+  TestWidgetsFlutterBinding.ensureInitialized();
+
+  late MethodChannelRichClipboard clipboard;
+  late List<MethodCall> calls;
+
+  /// Answers method calls like the macOS, iOS and Android plugins, which
+  /// only know getData, setData and getAvailableTypes.
+  void mockBasicPlatform(List<String> availableTypes) {
+    channel.setMockMethodCallHandler((call) async {
+      calls.add(call);
+      switch (call.method) {
+        case 'getAvailableTypes':
+          return availableTypes;
+        case 'getData':
+        case 'setData':
+          return null;
+        default:
+          throw MissingPluginException();
+      }
+    });
+  }
+
+  setUp(() {
+    clipboard = MethodChannelRichClipboard();
+    calls = [];
+  });
+
+  tearDown(() {
+    channel.setMockMethodCallHandler(null);
+    debugDefaultTargetPlatformOverride = null;
+  });
+
+  group('hasTypes', () {
+    test('decodes the bitmask', () async {
+      channel.setMockMethodCallHandler((call) async {
+        calls.add(call);
+        return 0x5;
+      });
+
+      expect(
+        await clipboard.hasTypes(['text/plain', 'text/html', 'image/png']),
+        [true, false, true],
+      );
+      expect(calls.map((call) => call.method), ['hasTypes']);
+    });
+
+    test('falls back to getAvailableTypes without a native handler',
+        () async {
+      mockBasicPlatform(['text/plain']);
+
+      expect(
+        await clipboard.hasTypes(['text/html', 'text/plain']),
+        [false, true],
+      );
+      expect(
+        calls.map((call) => call.method),
+        ['hasTypes', 'getAvailableTypes'],
+      );
+    });
+  });
+
+  group('setHtmlData', () {
+    test('asks Linux to derive the plain text', () async {
+      debugDefaultTargetPlatformOverride = TargetPlatform.linux;
+      mockBasicPlatform([]);
+
+      await clipboard.setHtmlData('<b>hello</b>');
+
+      expect(calls, hasLength(1));
+      expect(calls.single.method, 'setData');
+      expect(calls.single.arguments, {
+        'text/html': '<b>hello</b>',
+        'derivePlainText': true,
+      });
+    });
+
+    test('is unimplemented on other platforms', () async {
+      for (final platform in [
+        TargetPlatform.android,
+        TargetPlatform.iOS,
+        TargetPlatform.macOS,
+      ]) {
+        debugDefaultTargetPlatformOverride = platform;
+        mockBasicPlatform([]);
+
+        await expectLater(
+          clipboard.setHtmlData('<b>hello</b>'),
+          throwsUnimplementedError,
+        );
+      }
+      expect(calls, isEmpty);
+    });
+  });
+}
@@ -0,0 +1,105 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:rich_clipboard_platform_interface/rich_clipboard_platform_interface.dart';
+
+/// A platform that only implements the required methods, so every other
+/// method runs the interface's fallback.
+class FakeRichClipboard extends RichClipboardPlatform {
+  RichClipboardData data = const RichClipboardData();
+  List<String> availableTypes = [];
+  int getDataCalls = 0;
+
+  @override
+  Future<RichClipboardData> getData() async {
+    getDataCalls++;
+    return data;
+  }
+
+  @override
+  Future<List<String>> getAvailableTypes() async => availableTypes;
+
+  @override
+  Future<void> setData(RichClipboardData data) async {
+    this.data = data;
+  }
+}
+
+void main() {
+  late FakeRichClipboard clipboard;
+
+  setUp(() {
+    clipboard = FakeRichClipboard();
+  });
+
+  group('getDataOfTypes', () {
+    const both = RichClipboardData(text: 'hello', html: '<b>hello</b>');
+
+    test('returns only the requested types', () async {
+      clipboard.data = both;
+
+      expect(
+        await clipboard.getDataOfTypes(['text/plain']),
+        const RichClipboardData(text: 'hello'),
+      );
+      expect(
+        await clipboard.getDataOfTypes(['text/html']),
+        const RichClipboardData(html: '<b>hello</b>'),
+      );
+      expect(
+        await clipboard.getDataOfTypes(['text/html', 'text/plain']),
+        both,
+      );
+    });
+
+    test('returns empty data for no or unknown types', () async {
+      clipboard.data = both;
+
+      expect(
+        await clipboard.getDataOfTypes([]),
+        const RichClipboardData(),
+      );
+      expect(
+        await clipboard.getDataOfTypes(['image/png']),
+        const RichClipboardData(),
+      );
+    });
+
+    test('leaves out requested types the clipboard does not hold', () async {
+      clipboard.data = const RichClipboardData(text: 'hello');
+
+      expect(
+        await clipboard.getDataOfTypes(['text/plain', 'text/html']),
+        const RichClipboardData(text: 'hello'),
+      );
+    });
+
+    test('reads the clipboard once', () async {
+      await clipboard.getDataOfTypes(['text/plain', 'text/html']);
+
+      expect(clipboard.getDataCalls, 1);
+    });
+  });
+
+  group('hasTypes', () {
+    test('checks each type against the available types, in order', () async {
+      clipboard.availableTypes = ['text/plain', 'image/png'];
+
+      expect(
+        await clipboard.hasTypes(['image/png', 'text/html', 'text/plain']),
+        [true, false, true],
+      );
+    });
+
+    test('reports nothing available on an empty clipboard', () async {
+      expect(
+        await clipboard.hasTypes(['text/plain', 'text/html']),
+        [false, false],
+      );
+    });
+
+    test('returns an empty list for no types', () async {
+      clipboard.availableTypes = ['text/plain'];
+
+      expect(await clipboard.hasTypes([]), isEmpty);
+    });
+  });
+}